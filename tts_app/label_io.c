@@ -0,0 +1,289 @@
+/*
+ *  Copyright (c) Toshihiro Kobayashi <kobacha@mwa.biglobe.ne.jp>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Full-context label streams between the front end and the back end.
+ *
+ * Stream format (all integers little endian):
+ *   header:	"OJTL", u32 version
+ *   utterance:	u32 number of labels, { u16 length, bytes } per label
+ *
+ * The reader also accepts a plain full-context label file (one label
+ * per line, optionally preceded by start and end times), which is read
+ * as a single utterance.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "label_io.h"
+#ifndef DEBUG_LEVEL_LABEL_IO
+#define DEBUG_LEVEL_LABEL_IO	0
+#endif
+#define DEBUG_HEAD_LABEL_IO	"[label_io] "
+
+#include "debug.h"
+
+#define LABEL_MAGIC		"OJTL"
+#define LABEL_VERSION		1
+
+/* far more than an utterance has; a larger count means a broken stream */
+#define LABEL_MAX_LABELS	65536
+
+typedef struct label_reader {
+	FILE *fp;
+	int stream;		/* serialized stream, not a plain file */
+	int done;
+	char *buf;
+	size_t buf_size;
+	char **label;
+	size_t *offset;		/* of each label in buf while reading */
+	int label_max;
+	int nr_plain;		/* labels of a plain file */
+} label_reader_ctl_t;
+
+static void put_u32(unsigned char *p, unsigned int v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static unsigned int get_u32(const unsigned char *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+int label_write_header(FILE *fp)
+{
+	unsigned char ver[4];
+
+	put_u32(ver, LABEL_VERSION);
+	if (fwrite(LABEL_MAGIC, 1, 4, fp) != 4 ||
+	    fwrite(ver, 1, sizeof(ver), fp) != sizeof(ver))
+		return -1;
+	return 0;
+}
+
+/* writes one utterance and flushes it so that a pipeline keeps flowing */
+int label_write(FILE *fp, char **label, int label_size)
+{
+	unsigned char b[4];
+	size_t n;
+	int i;
+
+	put_u32(b, label_size);
+	if (fwrite(b, 1, 4, fp) != 4)
+		return -1;
+	for (i = 0; i < label_size; i++) {
+		n = strlen(label[i]);
+		if (n > 0xffff)
+			n = 0xffff;
+		b[0] = n;
+		b[1] = n >> 8;
+		if (fwrite(b, 1, 2, fp) != 2 ||
+		    fwrite(label[i], 1, n, fp) != n)
+			return -1;
+	}
+	if (fflush(fp) == EOF)
+		return -1;
+
+	return 0;
+}
+
+static int reserve(label_reader_ctl_t *reader, size_t size, int nr_labels)
+{
+	if (size > reader->buf_size) {
+		char *p = realloc(reader->buf, size);
+
+		if (p == NULL)
+			return -1;
+		reader->buf = p;
+		reader->buf_size = size;
+	}
+	if (nr_labels > reader->label_max) {
+		int max = (reader->label_max > 0) ? reader->label_max : 64;
+		char **p;
+		size_t *q;
+
+		while (max < nr_labels)
+			max *= 2;
+		p = realloc(reader->label, max * sizeof(char *));
+		if (p == NULL)
+			return -1;
+		reader->label = p;
+		q = realloc(reader->offset, max * sizeof(size_t));
+		if (q == NULL)
+			return -1;
+		reader->offset = q;
+		reader->label_max = max;
+	}
+	return 0;
+}
+
+/* reads the rest of a plain label file; head holds bytes already read */
+static int read_plain(label_reader_ctl_t *reader, const char *head,
+		      size_t head_len)
+{
+	size_t len = head_len;
+	size_t n;
+	int nr_labels = 0;
+	char *p, *next;
+
+	if (reserve(reader, 4096, 0) < 0)
+		return -1;
+	memcpy(reader->buf, head, head_len);
+	for (;;) {
+		n = fread(reader->buf + len, 1, reader->buf_size - len - 1,
+			  reader->fp);
+		len += n;
+		if (len < reader->buf_size - 1)
+			break;
+		if (reserve(reader, reader->buf_size * 2, 0) < 0)
+			return -1;
+	}
+	reader->buf[len] = '\0';
+
+	for (p = reader->buf; *p != '\0'; p = next) {
+		next = p + strcspn(p, "\r\n");
+		if (*next != '\0')
+			*next++ = '\0';
+		if (*p == '\0')
+			continue;
+		if (reserve(reader, 0, nr_labels + 1) < 0)
+			return -1;
+		reader->label[nr_labels++] = p;
+	}
+	reader->nr_plain = nr_labels;
+
+	return nr_labels;
+}
+
+label_reader_t label_open(FILE *fp)
+{
+	label_reader_ctl_t *reader;
+	unsigned char hdr[8];
+	size_t n;
+
+	reader = calloc(1, sizeof(label_reader_ctl_t));
+	if (reader == NULL)
+		return NULL;
+	reader->fp = fp;
+
+	n = fread(hdr, 1, 4, fp);
+	if (n == 4 && !memcmp(hdr, LABEL_MAGIC, 4)) {
+		if (fread(hdr + 4, 1, 4, fp) != 4 ||
+		    get_u32(hdr + 4) != LABEL_VERSION) {
+			app_error("unsupported label stream.\n");
+			free(reader);
+			return NULL;
+		}
+		reader->stream = 1;
+		return reader;
+	}
+
+	/* plain label file: one utterance */
+	if (read_plain(reader, (char *)hdr, n) < 0) {
+		label_close(reader);
+		return NULL;
+	}
+	return reader;
+}
+
+void label_close(label_reader_t reader)
+{
+	free(reader->label);
+	free(reader->offset);
+	free(reader->buf);
+	free(reader);
+}
+
+/*
+ * *label points into the reader and stays valid until the next call.
+ * returns 1 on an utterance, 0 at the end and -1 on error.
+ */
+int label_read(label_reader_t reader, char ***label, int *label_size)
+{
+	unsigned char b[4];
+	size_t len = 0, n;
+	unsigned int nr_labels;
+	int i;
+
+	if (reader->done)
+		return 0;
+
+	if (!reader->stream) {
+		/* read_plain() has split the file already */
+		reader->done = 1;
+		*label = reader->label;
+		*label_size = reader->nr_plain;
+		return reader->nr_plain > 0;
+	}
+
+	if (fread(b, 1, 4, reader->fp) != 4) {
+		reader->done = 1;
+		return 0;
+	}
+	nr_labels = get_u32(b);
+	if (nr_labels == 0 || nr_labels > LABEL_MAX_LABELS ||
+	    reserve(reader, 4096, 0) < 0)
+		goto err;
+
+	/* grown as labels arrive, not by the count the stream claims */
+	for (i = 0; i < (int)nr_labels; i++) {
+		if (reserve(reader, 0, i + 1) < 0 ||
+		    fread(b, 1, 2, reader->fp) != 2)
+			goto err;
+		n = b[0] | b[1] << 8;
+		if (len + n + 1 > reader->buf_size &&
+		    reserve(reader, (len + n + 1) * 2, 0) < 0)
+			goto err;
+		if (fread(reader->buf + len, 1, n, reader->fp) != n)
+			goto err;
+		reader->offset[i] = len;
+		len += n;
+		reader->buf[len++] = '\0';
+	}
+	/* the buffer may have moved while growing */
+	for (i = 0; i < (int)nr_labels; i++)
+		reader->label[i] = reader->buf + reader->offset[i];
+
+	app_debug(LABEL_IO, 1, "%u labels\n", nr_labels);
+	*label = reader->label;
+	*label_size = nr_labels;
+	return 1;
+
+err:
+	app_error("broken label stream.\n");
+	reader->done = 1;
+	return -1;
+}
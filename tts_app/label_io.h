@@ -0,0 +1,15 @@
+#ifndef _LABEL_IO_H
+#define _LABEL_IO_H
+
+#include <stdio.h>
+
+typedef struct label_reader *label_reader_t;
+
+extern int label_write_header(FILE *fp);
+extern int label_write(FILE *fp, char **label, int label_size);
+
+extern label_reader_t label_open(FILE *fp);
+extern void label_close(label_reader_t reader);
+extern int label_read(label_reader_t reader, char ***label, int *label_size);
+
+#endif	/* _LABEL_IO_H */
@@ -0,0 +1,438 @@
+/*
+ *  Copyright (c) Toshihiro Kobayashi <kobacha@mwa.biglobe.ne.jp>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Software mixer for concurrent utterances on one PCM device.
+ *
+ * Each stream owns a ring buffer filled by mixer_write().  The mixer
+ * thread takes one period from every ready stream, applies the stream
+ * gain (attenuated by the duck gain while a stream of higher priority is
+ * sounding), sums them with saturation and feeds the result to
+ * play_write().  All streams share the device format (S16, interleaved).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "mixer.h"
+#ifndef DEBUG_LEVEL_MIXER
+#define DEBUG_LEVEL_MIXER	0
+#endif
+#define DEBUG_HEAD_MIXER	"[mixer] "
+
+#include "debug.h"
+
+/* ring buffer size of a stream, in periods */
+#define MIXER_RING_PERIODS	16
+
+#define MIXER_GAIN_ONE		32767	/* Q15 */
+#define MIXER_DUCK_GAIN		0.25
+
+typedef struct mixer_stream {
+	struct mixer_ctl *mixer_ctl;
+	struct mixer_stream *next;
+	short *ring;
+	size_t ring_len;	/* in samples */
+	size_t rd;
+	size_t count;
+	int gain;		/* Q15 */
+	int priority;
+	int flushing;		/* a short last period may be played */
+	int closing;
+} mixer_stream_ctl_t;
+
+typedef struct mixer_ctl {
+	play_handle_t play_h;
+	size_t period_len;	/* in samples */
+	short *acc;
+	short *tmp;
+	int duck_gain;		/* Q15 */
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;	/* data arrived or mixer is exiting */
+	pthread_cond_t space;	/* ring space freed or stream reaped */
+	mixer_stream_ctl_t *streams;
+	int running;		/* device is started */
+	int quit;
+} mixer_ctl_t;
+
+static int gain_q15(double gain)
+{
+	if (gain <= 0.0)
+		return 0;
+	if (gain >= 1.0)
+		return MIXER_GAIN_ONE;
+	return (int)(gain * 32768.0);
+}
+
+/* dst = src * gain (Q15) */
+static void scale(short *dst, const short *src, size_t n, int gain)
+{
+	size_t i = 0;
+
+	if (gain == MIXER_GAIN_ONE) {
+		memcpy(dst, src, n * sizeof(short));
+		return;
+	}
+#if defined(__SSE2__)
+	{
+		__m128i g = _mm_set1_epi16((short)gain);
+
+		for (; i + 8 <= n; i += 8) {
+			__m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+			__m128i lo = _mm_mullo_epi16(x, g);
+			__m128i hi = _mm_mulhi_epi16(x, g);
+			__m128i p0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15);
+			__m128i p1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15);
+
+			_mm_storeu_si128((__m128i *)(dst + i),
+					 _mm_packs_epi32(p0, p1));
+		}
+	}
+#elif defined(__ARM_NEON)
+	{
+		int16x8_t g = vdupq_n_s16((short)gain);
+
+		for (; i + 8 <= n; i += 8)
+			vst1q_s16(dst + i, vqdmulhq_s16(vld1q_s16(src + i), g));
+	}
+#endif
+	for (; i < n; i++)
+		dst[i] = (short)((src[i] * gain) >> 15);
+}
+
+/* acc += src, saturating */
+static void sat_add(short *acc, const short *src, size_t n)
+{
+	size_t i = 0;
+	int x;
+
+#if defined(__SSE2__)
+	for (; i + 8 <= n; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(acc + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+
+		_mm_storeu_si128((__m128i *)(acc + i), _mm_adds_epi16(a, b));
+	}
+#elif defined(__ARM_NEON)
+	for (; i + 8 <= n; i += 8)
+		vst1q_s16(acc + i, vqaddq_s16(vld1q_s16(acc + i),
+					      vld1q_s16(src + i)));
+#endif
+	for (; i < n; i++) {
+		x = acc[i] + src[i];
+		if (x > 32767)
+			x = 32767;
+		else if (x < -32768)
+			x = -32768;
+		acc[i] = (short)x;
+	}
+}
+
+/* a stream takes part in the next period if it can fill it */
+static int stream_ready(mixer_ctl_t *mixer_ctl, mixer_stream_ctl_t *s)
+{
+	return s->count >= mixer_ctl->period_len ||
+	       ((s->closing || s->flushing) && s->count > 0);
+}
+
+/* free closed streams which have been played out.  called with lock held */
+static void reap_streams(mixer_ctl_t *mixer_ctl)
+{
+	mixer_stream_ctl_t **sp = &mixer_ctl->streams;
+	mixer_stream_ctl_t *s;
+
+	while ((s = *sp) != NULL) {
+		if (s->closing && s->count == 0) {
+			*sp = s->next;
+			free(s->ring);
+			free(s);
+			pthread_cond_broadcast(&mixer_ctl->space);
+		} else {
+			sp = &s->next;
+		}
+	}
+}
+
+/* mix one period into mixer_ctl->acc.  called with lock held */
+static int mix_period(mixer_ctl_t *mixer_ctl)
+{
+	size_t period_len = mixer_ctl->period_len;
+	mixer_stream_ctl_t *s;
+	int max_priority = 0;
+	int nr_ready = 0;
+
+	for (s = mixer_ctl->streams; s != NULL; s = s->next) {
+		if (!stream_ready(mixer_ctl, s))
+			continue;
+		if (nr_ready++ == 0 || s->priority > max_priority)
+			max_priority = s->priority;
+	}
+	if (nr_ready == 0)
+		return 0;
+
+	memset(mixer_ctl->acc, 0, period_len * sizeof(short));
+	for (s = mixer_ctl->streams; s != NULL; s = s->next) {
+		size_t n, first;
+		int gain;
+
+		if (!stream_ready(mixer_ctl, s))
+			continue;
+		gain = s->gain;
+		if (s->priority < max_priority)
+			gain = (gain * mixer_ctl->duck_gain) >> 15;
+
+		n = (s->count < period_len) ? s->count : period_len;
+		first = s->ring_len - s->rd;
+		if (first > n)
+			first = n;
+		scale(mixer_ctl->tmp, s->ring + s->rd, first, gain);
+		scale(mixer_ctl->tmp + first, s->ring, n - first, gain);
+		sat_add(mixer_ctl->acc, mixer_ctl->tmp, n);
+
+		s->rd = (s->rd + n) % s->ring_len;
+		s->count -= n;
+		if (s->count == 0)
+			s->flushing = 0;
+	}
+	pthread_cond_broadcast(&mixer_ctl->space);
+
+	return nr_ready;
+}
+
+static void *mixer_main(void *arg)
+{
+	mixer_ctl_t *mixer_ctl = arg;
+	size_t period_bytes = mixer_ctl->period_len * sizeof(short);
+
+	pthread_mutex_lock(&mixer_ctl->lock);
+	for (;;) {
+		reap_streams(mixer_ctl);
+		if (mix_period(mixer_ctl) == 0) {
+			if (mixer_ctl->running) {
+				/* play out what is queued, restart on demand */
+				pthread_mutex_unlock(&mixer_ctl->lock);
+				play_drain(mixer_ctl->play_h);
+				pthread_mutex_lock(&mixer_ctl->lock);
+				mixer_ctl->running = 0;
+				continue;
+			}
+			if (mixer_ctl->quit && mixer_ctl->streams == NULL)
+				break;
+			pthread_cond_wait(&mixer_ctl->cond, &mixer_ctl->lock);
+			continue;
+		}
+
+		pthread_mutex_unlock(&mixer_ctl->lock);
+		if (!mixer_ctl->running) {
+			play_start(mixer_ctl->play_h);
+			mixer_ctl->running = 1;
+		}
+		play_write(mixer_ctl->play_h, mixer_ctl->acc, period_bytes);
+		pthread_mutex_lock(&mixer_ctl->lock);
+	}
+	pthread_mutex_unlock(&mixer_ctl->lock);
+
+	return NULL;
+}
+
+mixer_handle_t mixer_init(play_handle_t play_h, const play_info_t *play_info)
+{
+	mixer_ctl_t *mixer_ctl;
+
+	app_debug(MIXER, 3, "%s() in\n", __func__);
+	if (play_info->format != SND_PCM_FORMAT_S16_LE) {
+		app_error("mixer supports S16_LE only.\n");
+		return NULL;
+	}
+
+	mixer_ctl = calloc(1, sizeof(mixer_ctl_t));
+	if (mixer_ctl == NULL)
+		return NULL;
+	mixer_ctl->play_h = play_h;
+	mixer_ctl->period_len = play_info->chunk_bytes / sizeof(short);
+	mixer_ctl->duck_gain = gain_q15(MIXER_DUCK_GAIN);
+	mixer_ctl->acc = malloc(play_info->chunk_bytes);
+	mixer_ctl->tmp = malloc(play_info->chunk_bytes);
+	if (mixer_ctl->acc == NULL || mixer_ctl->tmp == NULL)
+		goto err;
+	pthread_mutex_init(&mixer_ctl->lock, NULL);
+	pthread_cond_init(&mixer_ctl->cond, NULL);
+	pthread_cond_init(&mixer_ctl->space, NULL);
+	if (pthread_create(&mixer_ctl->thread, NULL, mixer_main, mixer_ctl)) {
+		app_error("pthread_create() failed.\n");
+		pthread_cond_destroy(&mixer_ctl->space);
+		pthread_cond_destroy(&mixer_ctl->cond);
+		pthread_mutex_destroy(&mixer_ctl->lock);
+		goto err;
+	}
+
+	app_debug(MIXER, 1, "period_len = %zd\n", mixer_ctl->period_len);
+	app_debug(MIXER, 3, "%s() out\n", __func__);
+	return mixer_ctl;
+
+err:
+	free(mixer_ctl->tmp);
+	free(mixer_ctl->acc);
+	free(mixer_ctl);
+	return NULL;
+}
+
+/* plays out every stream (closing the ones left open) and stops */
+void mixer_exit(mixer_handle_t mixer_h)
+{
+	mixer_ctl_t *mixer_ctl = mixer_h;
+	mixer_stream_ctl_t *s;
+
+	app_debug(MIXER, 3, "%s() in\n", __func__);
+	pthread_mutex_lock(&mixer_ctl->lock);
+	for (s = mixer_ctl->streams; s != NULL; s = s->next)
+		s->closing = 1;
+	mixer_ctl->quit = 1;
+	pthread_cond_signal(&mixer_ctl->cond);
+	pthread_mutex_unlock(&mixer_ctl->lock);
+	pthread_join(mixer_ctl->thread, NULL);
+
+	pthread_cond_destroy(&mixer_ctl->space);
+	pthread_cond_destroy(&mixer_ctl->cond);
+	pthread_mutex_destroy(&mixer_ctl->lock);
+	free(mixer_ctl->tmp);
+	free(mixer_ctl->acc);
+	free(mixer_ctl);
+	app_debug(MIXER, 3, "%s() out\n", __func__);
+}
+
+/* gain applied to streams while one of higher priority is sounding */
+void mixer_set_duck_gain(mixer_handle_t mixer_h, double duck_gain)
+{
+	mixer_ctl_t *mixer_ctl = mixer_h;
+
+	pthread_mutex_lock(&mixer_ctl->lock);
+	mixer_ctl->duck_gain = gain_q15(duck_gain);
+	pthread_mutex_unlock(&mixer_ctl->lock);
+}
+
+/* gain is clipped to [0.0, 1.0] */
+mixer_stream_t mixer_open(mixer_handle_t mixer_h, double gain, int priority)
+{
+	mixer_ctl_t *mixer_ctl = mixer_h;
+	mixer_stream_ctl_t *s;
+
+	app_debug(MIXER, 3, "%s() in\n", __func__);
+	s = calloc(1, sizeof(mixer_stream_ctl_t));
+	if (s == NULL)
+		return NULL;
+	s->ring_len = mixer_ctl->period_len * MIXER_RING_PERIODS;
+	s->ring = malloc(s->ring_len * sizeof(short));
+	if (s->ring == NULL) {
+		free(s);
+		return NULL;
+	}
+	s->mixer_ctl = mixer_ctl;
+	s->gain = gain_q15(gain);
+	s->priority = priority;
+
+	pthread_mutex_lock(&mixer_ctl->lock);
+	s->next = mixer_ctl->streams;
+	mixer_ctl->streams = s;
+	pthread_mutex_unlock(&mixer_ctl->lock);
+
+	app_debug(MIXER, 3, "%s() out\n", __func__);
+	return s;
+}
+
+/* queues data, blocking while the ring buffer of the stream is full */
+ssize_t mixer_write(mixer_stream_t stream, const void *data, size_t size)
+{
+	mixer_stream_ctl_t *s = stream;
+	mixer_ctl_t *mixer_ctl = s->mixer_ctl;
+	const short *src = data;
+	size_t len = size / sizeof(short);
+	size_t n, wr, first;
+
+	app_debug(MIXER, 3, "%s() in\n", __func__);
+	pthread_mutex_lock(&mixer_ctl->lock);
+	while (len > 0) {
+		while (s->count == s->ring_len)
+			pthread_cond_wait(&mixer_ctl->space, &mixer_ctl->lock);
+
+		n = s->ring_len - s->count;
+		if (n > len)
+			n = len;
+		wr = (s->rd + s->count) % s->ring_len;
+		first = s->ring_len - wr;
+		if (first > n)
+			first = n;
+		memcpy(s->ring + wr, src, first * sizeof(short));
+		memcpy(s->ring, src + first, (n - first) * sizeof(short));
+		s->count += n;
+		src += n;
+		len -= n;
+		pthread_cond_signal(&mixer_ctl->cond);
+	}
+	pthread_mutex_unlock(&mixer_ctl->lock);
+
+	app_debug(MIXER, 3, "%s() out\n", __func__);
+	return size - size % sizeof(short);
+}
+
+/* lets a short last period play; the stream stays open */
+void mixer_flush(mixer_stream_t stream)
+{
+	mixer_stream_ctl_t *s = stream;
+	mixer_ctl_t *mixer_ctl = s->mixer_ctl;
+
+	pthread_mutex_lock(&mixer_ctl->lock);
+	s->flushing = 1;
+	pthread_cond_signal(&mixer_ctl->cond);
+	pthread_mutex_unlock(&mixer_ctl->lock);
+}
+
+/* the stream is freed by the mixer after its queued data is played */
+void mixer_close(mixer_stream_t stream)
+{
+	mixer_stream_ctl_t *s = stream;
+	mixer_ctl_t *mixer_ctl = s->mixer_ctl;
+
+	app_debug(MIXER, 3, "%s() in\n", __func__);
+	pthread_mutex_lock(&mixer_ctl->lock);
+	s->closing = 1;
+	pthread_cond_signal(&mixer_ctl->cond);
+	pthread_mutex_unlock(&mixer_ctl->lock);
+	app_debug(MIXER, 3, "%s() out\n", __func__);
+}
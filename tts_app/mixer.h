@@ -0,0 +1,22 @@
+#ifndef _MIXER_H
+#define _MIXER_H
+
+#include <sys/types.h>
+
+#include "play.h"
+
+typedef struct mixer_ctl *mixer_handle_t;
+typedef struct mixer_stream *mixer_stream_t;
+
+extern mixer_handle_t mixer_init(play_handle_t play_h,
+				 const play_info_t *play_info);
+extern void mixer_exit(mixer_handle_t mixer_h);
+extern void mixer_set_duck_gain(mixer_handle_t mixer_h, double duck_gain);
+extern mixer_stream_t mixer_open(mixer_handle_t mixer_h,
+				 double gain, int priority);
+extern ssize_t mixer_write(mixer_stream_t stream, const void *data,
+			   size_t size);
+extern void mixer_flush(mixer_stream_t stream);
+extern void mixer_close(mixer_stream_t stream);
+
+#endif	/* _MIXER_H */
@@ -29,6 +29,7 @@
 #include <time.h>
 #include <sys/uio.h>
 #include <sys/time.h>
+#include <pthread.h>
 
 #include "play.h"
 #ifndef DEBUG_LEVEL_PLAY
@@ -52,17 +53,23 @@ typedef struct play_ctl {
 	} hwparams;
 } play_ctl_t;
 
+/* shared by every play_ctl in the process */
 static int sound_use_count;
+static pthread_mutex_t sound_use_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static void sound_use(void)
 {
+	pthread_mutex_lock(&sound_use_lock);
 	sound_use_count++;
+	pthread_mutex_unlock(&sound_use_lock);
 }
 
 static void sound_unuse(void)
 {
+	pthread_mutex_lock(&sound_use_lock);
 	if (--sound_use_count == 0)
 		snd_config_update_free_global();
+	pthread_mutex_unlock(&sound_use_lock);
 }
 
 static int set_params(play_ctl_t *play_ctl, unsigned int buf_time_req,
@@ -211,7 +218,7 @@ do { \
 #endif
 
 /* I/O error handler */
-static void xrun(play_ctl_t *play_ctl)
+static int xrun(play_ctl_t *play_ctl)
 {
 	snd_pcm_status_t *status;
 	int res;
@@ -219,7 +226,7 @@ static void xrun(play_ctl_t *play_ctl)
 	snd_pcm_status_alloca(&status);
 	if ((res = snd_pcm_status(play_ctl->pcm_h, status)) < 0) {
 		app_error("status error: %s", snd_strerror(res));
-		exit(EXIT_FAILURE);
+		return res;
 	}
 	if (snd_pcm_status_get_state(status) == SND_PCM_STATE_XRUN) {
 		struct timeval now, diff, tstamp;
@@ -230,26 +237,26 @@ static void xrun(play_ctl_t *play_ctl)
 			  diff.tv_sec * 1000 + diff.tv_usec / 1000.0);
 		if ((res = snd_pcm_prepare(play_ctl->pcm_h)) < 0) {
 			app_error("xrun: prepare error: %s", snd_strerror(res));
-			exit(EXIT_FAILURE);
+			return res;
 		}
-		return;		/* ok, data should be accepted again */
+		return 0;	/* ok, data should be accepted again */
 	} else if (snd_pcm_status_get_state(status) == SND_PCM_STATE_DRAINING) {
 		app_error("capture stream format change? "
 			  "attempting recover...\n");
 		if ((res = snd_pcm_prepare(play_ctl->pcm_h))<0) {
 			app_error("xrun(DRAINING): prepare error: %s",
 				snd_strerror(res));
-			exit(EXIT_FAILURE);
+			return res;
 		}
-		return;
+		return 0;
 	}
 	app_error("read/write error, state = %s",
 		  snd_pcm_state_name(snd_pcm_status_get_state(status)));
-	exit(EXIT_FAILURE);
+	return -EIO;
 }
 
 /* I/O suspend handler */
-static void suspend(play_ctl_t *play_ctl)
+static int suspend(play_ctl_t *play_ctl)
 {
 	int res;
 
@@ -263,10 +270,11 @@ static void suspend(play_ctl_t *play_ctl)
 		if ((res = snd_pcm_prepare(play_ctl->pcm_h)) < 0) {
 			app_error("suspend: prepare error: %s",
 				  snd_strerror(res));
-			exit(EXIT_FAILURE);
+			return res;
 		}
 	}
 	fprintf(stderr, "Done.\n");
+	return 0;
 }
 
 static ssize_t
@@ -279,11 +287,13 @@ pcm_write(play_ctl_t *play_ctl, unsigned char *data, size_t wcount)
 		r = snd_pcm_writei(play_ctl->pcm_h, data, wcount);
 		if (r == -EAGAIN || (r >= 0 && (size_t)r < wcount))
 			snd_pcm_wait(play_ctl->pcm_h, 1000);
-		else if (r == -EPIPE)
-			xrun(play_ctl);
-		else if (r == -ESTRPIPE)
-			suspend(play_ctl);
-		else if (r < 0)
+		else if (r == -EPIPE) {
+			if ((r = xrun(play_ctl)) < 0)
+				return r;
+		} else if (r == -ESTRPIPE) {
+			if ((r = suspend(play_ctl)) < 0)
+				return r;
+		} else if (r < 0)
 			return r;
 		if (r > 0) {
 			result += r;
@@ -305,6 +315,8 @@ play_init(play_info_t *play_info, const char *pcm_name,
 
 	app_debug(PLAY, 3, "%s() in\n", __func__);
 	play_ctl = malloc(sizeof(play_ctl_t));
+	if (play_ctl == NULL)
+		return NULL;
 
 	snd_pcm_info_alloca(&pcm_info);
 
@@ -312,6 +324,7 @@ play_init(play_info_t *play_info, const char *pcm_name,
 	if (err < 0) {
 		app_error("snd_output_stdio_attach() failed. (%s)\n",
 			  snd_strerror(err));
+		free(play_ctl);
 		return NULL;
 	}
 
@@ -319,23 +332,23 @@ play_init(play_info_t *play_info, const char *pcm_name,
 	play_ctl->hwparams.rate = rate;
 	play_ctl->hwparams.channels = channels;
 
+	/* the global config must not be freed while opening */
+	sound_use();
 	err = snd_pcm_open(&play_ctl->pcm_h, pcm_name,
 			   SND_PCM_STREAM_PLAYBACK, 0);
 	if (err < 0) {
 		app_error("audio open error: %s", snd_strerror(err));
-		return NULL;
+		goto err_use;
 	}
 
 	if ((err = snd_pcm_info(play_ctl->pcm_h, pcm_info)) < 0) {
 		app_error("info error: %s", snd_strerror(err));
-		return NULL;
+		goto err_pcm;
 	}
 
 	/* setup sound hardware */
-	if (set_params(play_ctl, buf_time_us, buf_cnt_min) < 0) {
-		snd_pcm_close(play_ctl->pcm_h);
-		return NULL;
-	}
+	if (set_params(play_ctl, buf_time_us, buf_cnt_min) < 0)
+		goto err_pcm;
 	app_debug(PLAY, 1,
 		  "chunk_size = %ld, chunk_bytes = %zd, buf_cnt = %d\n",
 		  play_ctl->chunk_size, play_ctl->chunk_bytes,
@@ -347,10 +360,16 @@ play_init(play_info_t *play_info, const char *pcm_name,
 	play_info->rate = play_ctl->hwparams.rate;
 	play_info->channels = play_ctl->hwparams.channels;
 
-	sound_use();
-
 	app_debug(PLAY, 3, "%s() out\n", __func__);
 	return play_ctl;
+
+err_pcm:
+	snd_pcm_close(play_ctl->pcm_h);
+err_use:
+	sound_unuse();
+	snd_output_close(play_ctl->log);
+	free(play_ctl);
+	return NULL;
 }
 
 void play_exit(play_handle_t play_h)
@@ -0,0 +1,398 @@
+/*
+ *  Copyright (c) Toshihiro Kobayashi <kobacha@mwa.biglobe.ne.jp>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Intra-utterance parallel synthesis.
+ *
+ * The label sequence of one utterance is split at pauses (preferred) and
+ * accent phrase boundaries, and the segments are synthesized concurrently
+ * on engine instances sharing the loaded model.  Each segment is
+ * synthesized together with the neighbouring label on both sides so that
+ * the boundary phonemes see the same context as in a whole-utterance run;
+ * the samples of those extra labels are then cut off except for a short
+ * margin, over which adjacent segments are cross-faded.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "HTS_engine.h"
+
+#include "psynth.h"
+#ifndef DEBUG_LEVEL_PSYNTH
+#define DEBUG_LEVEL_PSYNTH	0
+#endif
+#define DEBUG_HEAD_PSYNTH	"[psynth] "
+
+#include "debug.h"
+
+/* segments shorter than this (in labels) are not worth a thread */
+#define PSYNTH_MIN_LABELS	8
+
+typedef struct psynth_seg {
+	int start;		/* first label of the segment */
+	int end;		/* next to the last label of the segment */
+	short *pcm;		/* head margin + core + tail margin */
+	size_t head;		/* margin samples before the core */
+	size_t core;		/* samples of labels [start, end) */
+	size_t tail;		/* margin samples after the core */
+} psynth_seg_t;
+
+typedef struct psynth_ctl {
+	HTS_Engine *engines;	/* one per job, sharing the model */
+	HTS_BandWork *works;	/* parameter generation of each engine */
+	int nr_jobs;
+	size_t xfade_len;
+
+	/* per-utterance state, shared with the job threads */
+	pthread_mutex_t lock;
+	char **label;
+	int label_size;
+	psynth_seg_t *seg;
+	int nr_segs;
+	int next_seg;
+	int failed;
+} psynth_ctl_t;
+
+typedef struct psynth_job {
+	psynth_ctl_t *psynth_ctl;
+	HTS_Engine *engine;
+	HTS_BandWork *work;
+	pthread_t thread;
+} psynth_job_t;
+
+static int is_pause(const char *label)
+{
+	return strstr(label, "-pau+") != NULL;
+}
+
+/* the "/F:" field of a full-context label describes its accent phrase */
+static int same_accent_phrase(const char *a, const char *b)
+{
+	const char *fa = strstr(a, "/F:");
+	const char *fb = strstr(b, "/F:");
+	size_t len;
+
+	if (fa == NULL || fb == NULL)
+		return 1;
+	len = strcspn(fa + 1, "/");
+	return len == strcspn(fb + 1, "/") && !strncmp(fa, fb, len + 1);
+}
+
+/*
+ * find a segment boundary in [lo, hi], preferring the label just after
+ * a pause.  returns the index of the first label of the next segment.
+ */
+static int find_cut(char **label, int label_size, int lo, int hi)
+{
+	int accent_cut = -1;
+	int i;
+
+	if (hi > label_size - 2)
+		hi = label_size - 2;
+	for (i = lo; i <= hi; i++) {
+		if (is_pause(label[i - 1]) && !is_pause(label[i]))
+			return i;
+		if (accent_cut < 0 && !is_pause(label[i - 1]) &&
+		    !is_pause(label[i]) &&
+		    !same_accent_phrase(label[i - 1], label[i]))
+			accent_cut = i;
+	}
+
+	return accent_cut;
+}
+
+static void split_labels(psynth_ctl_t *psynth_ctl)
+{
+	char **label = psynth_ctl->label;
+	int label_size = psynth_ctl->label_size;
+	int target = label_size / psynth_ctl->nr_jobs;
+	int start = 0;
+	int cut;
+
+	if (target < PSYNTH_MIN_LABELS)
+		target = PSYNTH_MIN_LABELS;
+
+	psynth_ctl->nr_segs = 0;
+	while (label_size - start >= target + target / 2) {
+		cut = find_cut(label, label_size,
+			       start + target, start + target + target / 2);
+		if (cut < 0)
+			cut = find_cut(label, label_size,
+				       start + target + target / 2 + 1,
+				       label_size - target / 2);
+		if (cut < 0)
+			break;
+		psynth_ctl->seg[psynth_ctl->nr_segs].start = start;
+		psynth_ctl->seg[psynth_ctl->nr_segs].end = cut;
+		psynth_ctl->nr_segs++;
+		start = cut;
+	}
+	psynth_ctl->seg[psynth_ctl->nr_segs].start = start;
+	psynth_ctl->seg[psynth_ctl->nr_segs].end = label_size;
+	psynth_ctl->nr_segs++;
+}
+
+/* number of samples generated for the label_index'th label */
+static size_t label_samples(HTS_Engine *engine, size_t label_index)
+{
+	size_t nstate = HTS_Engine_get_nstate(engine);
+	size_t frames = 0;
+	size_t i;
+
+	for (i = 0; i < nstate; i++)
+		frames += HTS_Engine_get_state_duration(engine,
+						label_index * nstate + i);
+
+	return frames * HTS_Engine_get_fperiod(engine);
+}
+
+static int synth_seg(psynth_ctl_t *psynth_ctl, HTS_Engine *engine,
+		     HTS_BandWork *work, psynth_seg_t *seg)
+{
+	int from = (seg->start > 0) ? seg->start - 1 : 0;
+	int to = (seg->end < psynth_ctl->label_size) ? seg->end + 1 : seg->end;
+	size_t margin = psynth_ctl->xfade_len / 2;
+	size_t lead = 0, trail = 0;
+	size_t pcm_len;
+	short *pcm;
+
+	if (HTS_Engine_synthesize_from_strings_banded(engine,
+						      &psynth_ctl->label[from],
+						      to - from, work) != TRUE) {
+		HTS_Engine_refresh(engine);
+		return -1;
+	}
+
+	pcm_len = HTS_Engine_get_generated_speech_size(engine);
+	if (from < seg->start)
+		lead = label_samples(engine, 0);
+	if (to > seg->end)
+		trail = label_samples(engine, to - from - 1);
+	if (lead + trail > pcm_len) {
+		HTS_Engine_refresh(engine);
+		return -1;
+	}
+
+	pcm = malloc(pcm_len * sizeof(short));
+	if (pcm == NULL) {
+		HTS_Engine_refresh(engine);
+		return -1;
+	}
+	HTS_Engine_get_generated_speech(engine, pcm);
+	HTS_Engine_refresh(engine);
+
+	seg->core = pcm_len - lead - trail;
+	seg->head = (lead < margin) ? lead : margin;
+	seg->tail = (trail < margin) ? trail : margin;
+	memmove(pcm, pcm + lead - seg->head,
+		(seg->head + seg->core + seg->tail) * sizeof(short));
+	seg->pcm = pcm;
+
+	app_debug(PSYNTH, 1, "labels [%d, %d): %zu samples (+%zu/%zu)\n",
+		  seg->start, seg->end, seg->core, seg->head, seg->tail);
+	return 0;
+}
+
+static void *job_main(void *arg)
+{
+	psynth_job_t *job = arg;
+	psynth_ctl_t *psynth_ctl = job->psynth_ctl;
+	int i;
+
+	for (;;) {
+		pthread_mutex_lock(&psynth_ctl->lock);
+		i = psynth_ctl->failed ? psynth_ctl->nr_segs
+				       : psynth_ctl->next_seg++;
+		pthread_mutex_unlock(&psynth_ctl->lock);
+		if (i >= psynth_ctl->nr_segs)
+			break;
+
+		if (synth_seg(psynth_ctl, job->engine, job->work,
+			      &psynth_ctl->seg[i]) < 0) {
+			app_error("synthesis of segment %d failed.\n", i);
+			pthread_mutex_lock(&psynth_ctl->lock);
+			psynth_ctl->failed = 1;
+			pthread_mutex_unlock(&psynth_ctl->lock);
+		}
+	}
+
+	return NULL;
+}
+
+/* concatenate the segment cores, cross-fading over the margins */
+static short *join_segs(psynth_ctl_t *psynth_ctl, size_t *pcm_len)
+{
+	psynth_seg_t *seg = psynth_ctl->seg;
+	size_t len = 0, pos = 0;
+	short *pcm;
+	int i;
+
+	for (i = 0; i < psynth_ctl->nr_segs; i++)
+		len += seg[i].core;
+	pcm = malloc(len * sizeof(short));
+	if (pcm == NULL)
+		return NULL;
+
+	for (i = 0; i < psynth_ctl->nr_segs; i++) {
+		memcpy(pcm + pos, seg[i].pcm + seg[i].head,
+		       seg[i].core * sizeof(short));
+		if (i > 0) {
+			psynth_seg_t *a = &seg[i - 1], *b = &seg[i];
+			long before = (b->head < a->core) ? b->head : a->core;
+			long after = (a->tail < b->core) ? a->tail : b->core;
+			long span = before + after;
+			long d;
+
+			for (d = -before; d < after; d++) {
+				double w = (double)(d + before + 1) / (span + 1);
+				double x = a->pcm[a->head + a->core + d] * (1.0 - w) +
+					   b->pcm[b->head + d] * w;
+				pcm[pos + d] = (short)x;
+			}
+		}
+		pos += seg[i].core;
+	}
+
+	*pcm_len = len;
+	return pcm;
+}
+
+/*
+ * The job engines are shallow copies of the loaded engine: they share
+ * the model set and synthesis condition, and own only the per-utterance
+ * label/stream state.  Thus this must be called after all parameters are
+ * set, and the copies are never passed to HTS_Engine_clear().
+ * The engine must not use the HTS audio buffer (-z).
+ */
+psynth_handle_t
+psynth_init(HTS_Engine *engine, int nr_jobs, size_t xfade_len)
+{
+	psynth_ctl_t *psynth_ctl;
+	int i;
+
+	app_debug(PSYNTH, 3, "%s() in\n", __func__);
+	psynth_ctl = calloc(1, sizeof(psynth_ctl_t));
+	if (psynth_ctl == NULL)
+		return NULL;
+	psynth_ctl->engines = malloc(nr_jobs * sizeof(HTS_Engine));
+	psynth_ctl->works = malloc(nr_jobs * sizeof(HTS_BandWork));
+	if (psynth_ctl->engines == NULL || psynth_ctl->works == NULL) {
+		free(psynth_ctl->engines);
+		free(psynth_ctl->works);
+		free(psynth_ctl);
+		return NULL;
+	}
+	for (i = 0; i < nr_jobs; i++) {
+		psynth_ctl->engines[i] = *engine;
+		HTS_BandWork_initialize(&psynth_ctl->works[i]);
+	}
+	psynth_ctl->nr_jobs = nr_jobs;
+	psynth_ctl->xfade_len = xfade_len;
+	pthread_mutex_init(&psynth_ctl->lock, NULL);
+
+	app_debug(PSYNTH, 3, "%s() out\n", __func__);
+	return psynth_ctl;
+}
+
+void psynth_exit(psynth_handle_t psynth_h)
+{
+	psynth_ctl_t *psynth_ctl = psynth_h;
+	int i;
+
+	app_debug(PSYNTH, 3, "%s() in\n", __func__);
+	pthread_mutex_destroy(&psynth_ctl->lock);
+	for (i = 0; i < psynth_ctl->nr_jobs; i++)
+		HTS_BandWork_clear(&psynth_ctl->works[i]);
+	free(psynth_ctl->works);
+	free(psynth_ctl->engines);
+	free(psynth_ctl);
+	app_debug(PSYNTH, 3, "%s() out\n", __func__);
+}
+
+short *psynth_synthesize(psynth_handle_t psynth_h,
+			 char **label, int label_size, size_t *pcm_len)
+{
+	psynth_ctl_t *psynth_ctl = psynth_h;
+	psynth_job_t *job;
+	short *pcm = NULL;
+	int nr_threads;
+	int i;
+
+	app_debug(PSYNTH, 3, "%s() in\n", __func__);
+
+	psynth_ctl->seg = calloc(label_size, sizeof(psynth_seg_t));
+	job = calloc(psynth_ctl->nr_jobs, sizeof(psynth_job_t));
+	if (psynth_ctl->seg == NULL || job == NULL)
+		goto out;
+	psynth_ctl->label = label;
+	psynth_ctl->label_size = label_size;
+	psynth_ctl->next_seg = 0;
+	psynth_ctl->failed = 0;
+	split_labels(psynth_ctl);
+	app_debug(PSYNTH, 1, "%d labels -> %d segments\n",
+		  label_size, psynth_ctl->nr_segs);
+
+	nr_threads = (psynth_ctl->nr_segs < psynth_ctl->nr_jobs) ?
+		     psynth_ctl->nr_segs : psynth_ctl->nr_jobs;
+	for (i = 0; i < nr_threads; i++) {
+		job[i].psynth_ctl = psynth_ctl;
+		job[i].engine = &psynth_ctl->engines[i];
+		job[i].work = &psynth_ctl->works[i];
+	}
+	/* job 0 runs on the caller; the others fall back to it on failure */
+	for (i = 1; i < nr_threads; i++) {
+		if (pthread_create(&job[i].thread, NULL, job_main, &job[i])) {
+			app_error("pthread_create() failed.\n");
+			nr_threads = i;
+			break;
+		}
+	}
+	job_main(&job[0]);
+	for (i = 1; i < nr_threads; i++)
+		pthread_join(job[i].thread, NULL);
+
+	if (!psynth_ctl->failed)
+		pcm = join_segs(psynth_ctl, pcm_len);
+
+out:
+	if (psynth_ctl->seg != NULL) {
+		for (i = 0; i < psynth_ctl->nr_segs; i++)
+			free(psynth_ctl->seg[i].pcm);
+		free(psynth_ctl->seg);
+		psynth_ctl->seg = NULL;
+	}
+	free(job);
+
+	app_debug(PSYNTH, 3, "%s() out\n", __func__);
+	return pcm;
+}
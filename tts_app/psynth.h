@@ -0,0 +1,16 @@
+#ifndef _PSYNTH_H
+#define _PSYNTH_H
+
+#include <stddef.h>
+
+#include "HTS_engine.h"
+
+typedef struct psynth_ctl *psynth_handle_t;
+
+extern psynth_handle_t
+psynth_init(HTS_Engine *engine, int nr_jobs, size_t xfade_len);
+extern void psynth_exit(psynth_handle_t psynth_h);
+extern short *psynth_synthesize(psynth_handle_t psynth_h,
+				char **label, int label_size, size_t *pcm_len);
+
+#endif	/* _PSYNTH_H */
@@ -0,0 +1,100 @@
+/*
+ *  Copyright (c) Toshihiro Kobayashi <kobacha@mwa.biglobe.ne.jp>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Leading/trailing silence detection.
+ *
+ * JPCommon_make_label() brackets every utterance with "sil" labels.  When
+ * the engine still holds the state durations of the utterance, their
+ * length is read from there; otherwise (e.g. for parallel synthesis) the
+ * output is scanned for frames whose mean amplitude stays below a level.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "HTS_engine.h"
+
+#include "silence.h"
+
+/* energy detector: 5ms frames, about -54dBFS */
+#define SILENCE_FRAME_MS	5
+#define SILENCE_LEVEL		64
+
+/* the label is "p1^p2-p3+p4=p5..." with p3 the current phoneme */
+static int is_sil(const char *label)
+{
+	const char *p = strchr(label, '-');
+
+	return (p != NULL && strncmp(p + 1, "sil+", 4) == 0);
+}
+
+size_t silence_label_len(HTS_Engine *engine, char **label, int label_size,
+			 int tail)
+{
+	size_t nstate = HTS_Engine_get_nstate(engine);
+	size_t index, frames = 0;
+	size_t i;
+
+	if (label_size < 1 || nstate == 0 ||
+	    HTS_Engine_get_total_state(engine) != (size_t)label_size * nstate)
+		return 0;
+	index = tail ? (size_t)label_size - 1 : 0;
+	if (!is_sil(label[index]))
+		return 0;
+	for (i = 0; i < nstate; i++)
+		frames += HTS_Engine_get_state_duration(engine,
+							index * nstate + i);
+
+	return frames * HTS_Engine_get_fperiod(engine);
+}
+
+size_t silence_scan(const short *pcm, size_t pcm_len, int rate, int tail)
+{
+	size_t frame_len = (size_t)rate * SILENCE_FRAME_MS / 1000;
+	size_t len = 0;
+
+	if (frame_len == 0)
+		frame_len = 1;
+	while (len + frame_len <= pcm_len) {
+		const short *p = tail ? pcm + pcm_len - len - frame_len
+				      : pcm + len;
+		long sum = 0;
+		size_t i;
+
+		for (i = 0; i < frame_len; i++)
+			sum += abs(p[i]);
+		if (sum > (long)(SILENCE_LEVEL * frame_len))
+			break;
+		len += frame_len;
+	}
+
+	return len;
+}
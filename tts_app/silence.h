@@ -0,0 +1,15 @@
+#ifndef _SILENCE_H
+#define _SILENCE_H
+
+#include <stddef.h>
+
+#include "HTS_engine.h"
+
+/* samples of the leading (tail == 0) or trailing "sil" label */
+extern size_t silence_label_len(HTS_Engine *engine, char **label,
+				int label_size, int tail);
+/* samples of silence at the head (tail == 0) or tail of the pcm */
+extern size_t silence_scan(const short *pcm, size_t pcm_len, int rate,
+			   int tail);
+
+#endif	/* _SILENCE_H */
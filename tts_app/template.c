@@ -0,0 +1,272 @@
+/*
+ *  Copyright (c) Toshihiro Kobayashi <kobacha@mwa.biglobe.ne.jp>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Carrier-phrase templates.
+ *
+ * A template such as "次は{東京}です" is rendered once as a whole, with
+ * the sample filler in each slot, so that the fixed carrier segments are
+ * spoken in their sentence context.  The carrier samples are cut at the
+ * label boundaries of the fillers and kept.  Per request only the slot
+ * texts are synthesized; the pieces are then joined with cross-fades
+ * over the margins kept on both sides of each cut.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "HTS_engine.h"
+
+#include "template.h"
+#ifndef DEBUG_LEVEL_TEMPLATE
+#define DEBUG_LEVEL_TEMPLATE	0
+#endif
+#define DEBUG_HEAD_TEMPLATE	"[template] "
+
+#include "debug.h"
+
+typedef struct template {
+	int nr_slots;
+	template_piece_t *carrier;	/* nr_slots + 1 pieces */
+} template_t;
+
+typedef struct template_ctl {
+	template_t *tmpl;
+	int nr_tmpls;
+} template_ctl_t;
+
+template_handle_t template_init(void)
+{
+	return calloc(1, sizeof(template_ctl_t));
+}
+
+void template_exit(template_handle_t template_h)
+{
+	template_ctl_t *template_ctl = template_h;
+	int i, j;
+
+	for (i = 0; i < template_ctl->nr_tmpls; i++) {
+		template_t *tmpl = &template_ctl->tmpl[i];
+
+		for (j = 0; j <= tmpl->nr_slots; j++)
+			free(tmpl->carrier[j].pcm);
+		free(tmpl->carrier);
+	}
+	free(template_ctl->tmpl);
+	free(template_ctl);
+}
+
+/* takes over the carrier array and its samples; returns the template id */
+int template_add(template_handle_t template_h,
+		 int nr_slots, template_piece_t *carrier)
+{
+	template_ctl_t *template_ctl = template_h;
+	template_t *tmpl;
+
+	tmpl = realloc(template_ctl->tmpl,
+		       (template_ctl->nr_tmpls + 1) * sizeof(template_t));
+	if (tmpl == NULL)
+		return -1;
+	template_ctl->tmpl = tmpl;
+	tmpl += template_ctl->nr_tmpls;
+	tmpl->nr_slots = nr_slots;
+	tmpl->carrier = carrier;
+
+	app_debug(TEMPLATE, 1, "template %d: %d slots\n",
+		  template_ctl->nr_tmpls, nr_slots);
+	return template_ctl->nr_tmpls++;
+}
+
+int template_nr_slots(template_handle_t template_h, int id)
+{
+	template_ctl_t *template_ctl = template_h;
+
+	if (id < 0 || id >= template_ctl->nr_tmpls)
+		return -1;
+	return template_ctl->tmpl[id].nr_slots;
+}
+
+/* carrier and slot pieces alternate: c0 s0 c1 s1 ... cN */
+short *template_join(template_handle_t template_h, int id,
+		     const template_piece_t *slot, size_t *pcm_len)
+{
+	template_ctl_t *template_ctl = template_h;
+	template_t *tmpl = &template_ctl->tmpl[id];
+	int nr_pieces = tmpl->nr_slots * 2 + 1;
+	const template_piece_t *a = NULL, *b;
+	size_t len = 0, pos = 0;
+	short *pcm;
+	int i;
+
+	for (i = 0; i < nr_pieces; i++) {
+		b = (i & 1) ? &slot[i / 2] : &tmpl->carrier[i / 2];
+		len += b->core;
+	}
+	pcm = malloc((len ? len : 1) * sizeof(short));
+	if (pcm == NULL)
+		return NULL;
+
+	for (i = 0; i < nr_pieces; i++) {
+		b = (i & 1) ? &slot[i / 2] : &tmpl->carrier[i / 2];
+		memcpy(pcm + pos, b->pcm + b->head, b->core * sizeof(short));
+		if (a != NULL) {
+			long before = (b->head < a->core) ? b->head : a->core;
+			long after = (a->tail < b->core) ? a->tail : b->core;
+			long span = before + after;
+			long d;
+
+			for (d = -before; d < after; d++) {
+				double w = (double)(d + before + 1) / (span + 1);
+				double x = a->pcm[a->head + a->core + d] * (1.0 - w) +
+					   b->pcm[b->head + d] * w;
+				pcm[pos + d] = (short)x;
+			}
+		}
+		pos += b->core;
+		a = b;
+	}
+
+	*pcm_len = len;
+	return pcm;
+}
+
+/*
+ * "text{filler}text..." into the text with the fillers in place and the
+ * filler strings.  Returns the number of slots.
+ */
+int template_parse(const char *tmpl, char **text, char ***filler)
+{
+	const char *p, *q;
+	char *t;
+	int nr_slots = 0;
+
+	for (p = tmpl; (p = strchr(p, '{')) != NULL; p = q + 1) {
+		q = strchr(p, '}');
+		if (q == NULL || q == p + 1)
+			return -1;	/* unterminated or no sample filler */
+		nr_slots++;
+	}
+	*text = malloc(strlen(tmpl) + 1);
+	*filler = calloc(nr_slots ? nr_slots : 1, sizeof(char *));
+	if (*text == NULL || *filler == NULL)
+		goto err;
+
+	t = *text;
+	nr_slots = 0;
+	for (p = tmpl; *p != '\0'; p++) {
+		if (*p == '}')
+			continue;
+		if (*p != '{') {
+			*t++ = *p;
+			continue;
+		}
+		q = strchr(p, '}');
+		(*filler)[nr_slots] = strndup(p + 1, q - p - 1);
+		if ((*filler)[nr_slots++] == NULL)
+			goto err;
+		memcpy(t, p + 1, q - p - 1);
+		t += q - p - 1;
+		p = q;
+	}
+	*t = '\0';
+
+	return nr_slots;
+
+err:
+	if (*filler != NULL)
+		template_free_filler(*filler, nr_slots);
+	free(*text);
+	return -1;
+}
+
+void template_free_filler(char **filler, int nr_slots)
+{
+	int i;
+
+	for (i = 0; i < nr_slots; i++)
+		free(filler[i]);
+	free(filler);
+}
+
+/* the label is "p1^p2-p3+p4=p5..." with p3 the current phoneme */
+static int phoneme(const char *label, const char **p3)
+{
+	const char *s = strchr(label, '-');
+	const char *e;
+
+	if (s == NULL || (e = strchr(++s, '+')) == NULL)
+		return -1;
+	*p3 = s;
+	return e - s;
+}
+
+/*
+ * Index of the phonemes of sub (without its "sil" labels) in label,
+ * searched from the from'th label.  Unvoiced vowels compare equal to
+ * voiced ones, as devoicing depends on the neighbours.
+ */
+int template_find(char **label, int label_size, int from,
+		  char **sub, int sub_size)
+{
+	int n = sub_size - 2;
+	int i, j;
+
+	if (n <= 0)
+		return -1;
+	for (i = from; i + n <= label_size; i++) {
+		for (j = 0; j < n; j++) {
+			const char *a, *b;
+			int la = phoneme(label[i + j], &a);
+			int lb = phoneme(sub[j + 1], &b);
+
+			if (la < 0 || la != lb || strncasecmp(a, b, la))
+				break;
+		}
+		if (j == n)
+			return i;
+	}
+
+	return -1;
+}
+
+/* first sample of the label_index'th label */
+size_t template_label_offset(HTS_Engine *engine, int label_index)
+{
+	size_t nstate = HTS_Engine_get_nstate(engine);
+	size_t frames = 0;
+	size_t i;
+
+	for (i = 0; i < label_index * nstate; i++)
+		frames += HTS_Engine_get_state_duration(engine, i);
+
+	return frames * HTS_Engine_get_fperiod(engine);
+}
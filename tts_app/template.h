@@ -0,0 +1,33 @@
+#ifndef _TEMPLATE_H
+#define _TEMPLATE_H
+
+#include <stddef.h>
+
+#include "HTS_engine.h"
+
+typedef struct template_ctl *template_handle_t;
+
+/* head and tail are margins around the core, used for cross-fading */
+typedef struct template_piece {
+	short *pcm;
+	size_t head;
+	size_t core;
+	size_t tail;
+} template_piece_t;
+
+extern template_handle_t template_init(void);
+extern void template_exit(template_handle_t template_h);
+extern int template_add(template_handle_t template_h,
+			int nr_slots, template_piece_t *carrier);
+extern int template_nr_slots(template_handle_t template_h, int id);
+extern short *template_join(template_handle_t template_h, int id,
+			   const template_piece_t *slot, size_t *pcm_len);
+
+/* helpers for rendering the carrier segments */
+extern int template_parse(const char *tmpl, char **text, char ***filler);
+extern void template_free_filler(char **filler, int nr_slots);
+extern int template_find(char **label, int label_size, int from,
+			 char **sub, int sub_size);
+extern size_t template_label_offset(HTS_Engine *engine, int label_index);
+
+#endif	/* _TEMPLATE_H */
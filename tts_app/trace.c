@@ -0,0 +1,630 @@
+/*
+ *  Copyright (c) Toshihiro Kobayashi <kobacha@mwa.biglobe.ne.jp>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Asynchronous trace writer.
+ *
+ * The synthesis thread serializes the text analysis result, the labels,
+ * the state durations and the engine information of an utterance into
+ * a preallocated record buffer, and trace_commit() copies the record
+ * into a ring buffer.
+ * A background thread takes records out of the ring and writes them
+ * either as they are (binary) or formatted as text.  When the ring is
+ * full the record is dropped rather than stalling synthesis.
+ *
+ * Binary format (all integers little endian):
+ *   file header:	"OJTT", u32 version
+ *   record:		u32 record length (including itself), u32 sequence,
+ *			entries of { u8 type, u32 payload length, payload }
+ *   strings:		u16 length, bytes (not terminated)
+ *
+ * The engine information is kept as the text HTS_Engine_save_information()
+ * writes, since it is made of model lookups that are only valid while the
+ * utterance is alive.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "trace.h"
+#ifndef DEBUG_LEVEL_TRACE
+#define DEBUG_LEVEL_TRACE	0
+#endif
+#define DEBUG_HEAD_TRACE	"[trace] "
+
+#include "debug.h"
+
+#define TRACE_MAGIC		"OJTT"
+#define TRACE_VERSION		1
+
+#define TRACE_REC_SIZE		(1024 * 1024)
+#define TRACE_RING_SIZE		(4 * 1024 * 1024)
+#define TRACE_MAXSTRLEN		1024
+
+enum {
+	TRACE_ENTRY_TEXT = 1,
+	TRACE_ENTRY_NJD,
+	TRACE_ENTRY_LABEL,
+	TRACE_ENTRY_ENGINE,
+	TRACE_ENTRY_INFO,
+};
+
+typedef struct trace_ctl {
+	FILE *fp;
+	trace_format_t format;
+
+	/* record being captured; owned by the synthesis thread */
+	unsigned char *rec;
+	size_t rec_len;
+	size_t entry;		/* offset of the open entry */
+	int overflow;
+	unsigned int seq;
+	unsigned int dropped;
+
+	/* records waiting to be written */
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	unsigned char *ring;
+	size_t rd;
+	size_t count;
+	int quit;
+} trace_ctl_t;
+
+static void put_bytes(trace_ctl_t *trace_ctl, const void *p, size_t n)
+{
+	if (trace_ctl->overflow || trace_ctl->rec_len + n > TRACE_REC_SIZE) {
+		trace_ctl->overflow = 1;
+		return;
+	}
+	memcpy(trace_ctl->rec + trace_ctl->rec_len, p, n);
+	trace_ctl->rec_len += n;
+}
+
+static void put_u32_at(unsigned char *p, unsigned int v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static void put_u32(trace_ctl_t *trace_ctl, unsigned int v)
+{
+	unsigned char b[4];
+
+	put_u32_at(b, v);
+	put_bytes(trace_ctl, b, sizeof(b));
+}
+
+static void put_strn(trace_ctl_t *trace_ctl, const char *s, size_t n)
+{
+	unsigned char b[2];
+
+	if (n > 0xffff)
+		n = 0xffff;
+	b[0] = n;
+	b[1] = n >> 8;
+	put_bytes(trace_ctl, b, sizeof(b));
+	put_bytes(trace_ctl, s, n);
+}
+
+static void put_str(trace_ctl_t *trace_ctl, const char *s)
+{
+	put_strn(trace_ctl, s, (s != NULL) ? strlen(s) : 0);
+}
+
+static void open_entry(trace_ctl_t *trace_ctl, unsigned char type)
+{
+	trace_ctl->entry = trace_ctl->rec_len;
+	put_bytes(trace_ctl, &type, 1);
+	put_u32(trace_ctl, 0);	/* fixed up by close_entry() */
+}
+
+static void close_entry(trace_ctl_t *trace_ctl)
+{
+	if (trace_ctl->overflow)
+		return;
+	put_u32_at(trace_ctl->rec + trace_ctl->entry + 1,
+		   trace_ctl->rec_len - trace_ctl->entry - 5);
+}
+
+static unsigned int get_u32(const unsigned char *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+/* reads a string into buf (terminated), returns the bytes consumed */
+static size_t get_str(const unsigned char *p, const unsigned char *end,
+		      char *buf, size_t size)
+{
+	size_t n;
+
+	if (end - p < 2)
+		return end - p;
+	n = p[0] | p[1] << 8;
+	if ((size_t)(end - p - 2) < n)
+		n = end - p - 2;
+	if (size > 0) {
+		size_t m = (n < size - 1) ? n : size - 1;
+
+		memcpy(buf, p + 2, m);
+		buf[m] = '\0';
+	}
+	return n + 2;
+}
+
+static void ring_read(trace_ctl_t *trace_ctl, void *dst, size_t n)
+{
+	size_t first = TRACE_RING_SIZE - trace_ctl->rd;
+
+	if (first > n)
+		first = n;
+	memcpy(dst, trace_ctl->ring + trace_ctl->rd, first);
+	memcpy((unsigned char *)dst + first, trace_ctl->ring, n - first);
+	trace_ctl->rd = (trace_ctl->rd + n) % TRACE_RING_SIZE;
+	trace_ctl->count -= n;
+}
+
+static void *writer_main(void *arg)
+{
+	trace_ctl_t *trace_ctl = arg;
+	unsigned char *rec;
+	unsigned char hdr[4];
+	size_t len;
+
+	rec = malloc(TRACE_REC_SIZE);
+	if (rec == NULL)
+		return NULL;
+
+	pthread_mutex_lock(&trace_ctl->lock);
+	for (;;) {
+		while (trace_ctl->count == 0 && !trace_ctl->quit)
+			pthread_cond_wait(&trace_ctl->cond, &trace_ctl->lock);
+		if (trace_ctl->count == 0)
+			break;
+
+		ring_read(trace_ctl, hdr, sizeof(hdr));
+		len = get_u32(hdr);
+		memcpy(rec, hdr, sizeof(hdr));
+		ring_read(trace_ctl, rec + sizeof(hdr), len - sizeof(hdr));
+		pthread_mutex_unlock(&trace_ctl->lock);
+
+		if (trace_ctl->format == TRACE_FORMAT_BINARY)
+			fwrite(rec, 1, len, trace_ctl->fp);
+		else
+			trace_print_record(trace_ctl->fp, rec, len);
+
+		pthread_mutex_lock(&trace_ctl->lock);
+	}
+	pthread_mutex_unlock(&trace_ctl->lock);
+
+	fflush(trace_ctl->fp);
+	free(rec);
+	return NULL;
+}
+
+trace_handle_t trace_init(FILE *fp, trace_format_t format)
+{
+	trace_ctl_t *trace_ctl;
+	unsigned char ver[4];
+
+	app_debug(TRACE, 3, "%s() in\n", __func__);
+	trace_ctl = calloc(1, sizeof(trace_ctl_t));
+	if (trace_ctl == NULL)
+		return NULL;
+	trace_ctl->fp = fp;
+	trace_ctl->format = format;
+	trace_ctl->rec = malloc(TRACE_REC_SIZE);
+	trace_ctl->ring = malloc(TRACE_RING_SIZE);
+	if (trace_ctl->rec == NULL || trace_ctl->ring == NULL)
+		goto err;
+
+	if (format == TRACE_FORMAT_BINARY) {
+		put_u32_at(ver, TRACE_VERSION);
+		fwrite(TRACE_MAGIC, 1, 4, fp);
+		fwrite(ver, 1, sizeof(ver), fp);
+	}
+
+	pthread_mutex_init(&trace_ctl->lock, NULL);
+	pthread_cond_init(&trace_ctl->cond, NULL);
+	if (pthread_create(&trace_ctl->thread, NULL, writer_main, trace_ctl)) {
+		app_error("pthread_create() failed.\n");
+		pthread_cond_destroy(&trace_ctl->cond);
+		pthread_mutex_destroy(&trace_ctl->lock);
+		goto err;
+	}
+
+	app_debug(TRACE, 3, "%s() out\n", __func__);
+	return trace_ctl;
+
+err:
+	free(trace_ctl->ring);
+	free(trace_ctl->rec);
+	free(trace_ctl);
+	return NULL;
+}
+
+/* writes out every committed record */
+void trace_exit(trace_handle_t trace_h)
+{
+	trace_ctl_t *trace_ctl = trace_h;
+
+	app_debug(TRACE, 3, "%s() in\n", __func__);
+	pthread_mutex_lock(&trace_ctl->lock);
+	trace_ctl->quit = 1;
+	pthread_cond_signal(&trace_ctl->cond);
+	pthread_mutex_unlock(&trace_ctl->lock);
+	pthread_join(trace_ctl->thread, NULL);
+
+	if (trace_ctl->dropped > 0)
+		app_error("trace: %u records dropped.\n", trace_ctl->dropped);
+	pthread_cond_destroy(&trace_ctl->cond);
+	pthread_mutex_destroy(&trace_ctl->lock);
+	free(trace_ctl->ring);
+	free(trace_ctl->rec);
+	free(trace_ctl);
+	app_debug(TRACE, 3, "%s() out\n", __func__);
+}
+
+void trace_begin(trace_handle_t trace_h, const char *txt)
+{
+	trace_ctl_t *trace_ctl = trace_h;
+
+	trace_ctl->rec_len = 0;
+	trace_ctl->overflow = 0;
+	put_u32(trace_ctl, 0);	/* fixed up by trace_commit() */
+	put_u32(trace_ctl, trace_ctl->seq++);
+
+	open_entry(trace_ctl, TRACE_ENTRY_TEXT);
+	put_strn(trace_ctl, txt, strcspn(txt, "\r\n"));
+	close_entry(trace_ctl);
+}
+
+void trace_njd(trace_handle_t trace_h, NJD *njd)
+{
+	trace_ctl_t *trace_ctl = trace_h;
+	NJDNode *node;
+	unsigned int nr_nodes = 0;
+	size_t count_at;
+
+	open_entry(trace_ctl, TRACE_ENTRY_NJD);
+	count_at = trace_ctl->rec_len;
+	put_u32(trace_ctl, 0);
+	for (node = njd->head; node != NULL; node = node->next) {
+		put_str(trace_ctl, NJDNode_get_string(node));
+		put_str(trace_ctl, NJDNode_get_pos(node));
+		put_str(trace_ctl, NJDNode_get_pos_group1(node));
+		put_str(trace_ctl, NJDNode_get_pos_group2(node));
+		put_str(trace_ctl, NJDNode_get_pos_group3(node));
+		put_str(trace_ctl, NJDNode_get_ctype(node));
+		put_str(trace_ctl, NJDNode_get_cform(node));
+		put_str(trace_ctl, NJDNode_get_orig(node));
+		put_str(trace_ctl, NJDNode_get_read(node));
+		put_str(trace_ctl, NJDNode_get_pron(node));
+		put_u32(trace_ctl, NJDNode_get_acc(node));
+		put_u32(trace_ctl, NJDNode_get_mora_size(node));
+		put_str(trace_ctl, NJDNode_get_chain_rule(node));
+		put_u32(trace_ctl, NJDNode_get_chain_flag(node));
+		nr_nodes++;
+	}
+	if (!trace_ctl->overflow)
+		put_u32_at(trace_ctl->rec + count_at, nr_nodes);
+	close_entry(trace_ctl);
+}
+
+void trace_label(trace_handle_t trace_h, char **label, int label_size)
+{
+	trace_ctl_t *trace_ctl = trace_h;
+	int i;
+
+	open_entry(trace_ctl, TRACE_ENTRY_LABEL);
+	put_u32(trace_ctl, label_size);
+	for (i = 0; i < label_size; i++)
+		put_str(trace_ctl, label[i]);
+	close_entry(trace_ctl);
+}
+
+/*
+ * HTS_Engine_save_information() output, written straight into the
+ * record.  What does not fit is cut at a line boundary so that the
+ * rest of the record is kept.
+ */
+static void put_information(trace_ctl_t *trace_ctl, HTS_Engine *engine)
+{
+	char *buf;
+	size_t room;
+	long n;
+	FILE *fp;
+
+	open_entry(trace_ctl, TRACE_ENTRY_INFO);
+	if (trace_ctl->overflow)
+		return;
+	buf = (char *)trace_ctl->rec + trace_ctl->rec_len;
+	room = TRACE_REC_SIZE - trace_ctl->rec_len;
+	fp = (room > 1) ? fmemopen(buf, room, "w") : NULL;
+	if (fp == NULL) {
+		close_entry(trace_ctl);
+		return;
+	}
+	HTS_Engine_save_information(engine, fp);
+	fflush(fp);
+	n = ftell(fp);
+	fclose(fp);
+	if (n < 0)
+		n = 0;
+	/* the last byte is taken by the terminator when the text is cut */
+	if ((size_t)n >= room - 1) {
+		n = room - 1;
+		while (n > 0 && buf[n - 1] != '\n')
+			n--;
+		app_debug(TRACE, 1, "engine information of record %u cut to %ld bytes\n",
+			 trace_ctl->seq, n);
+	}
+	trace_ctl->rec_len += n;
+	close_entry(trace_ctl);
+}
+
+/* state durations of the utterance synthesized last on engine */
+void trace_engine(trace_handle_t trace_h, HTS_Engine *engine)
+{
+	trace_ctl_t *trace_ctl = trace_h;
+	size_t nr_states = HTS_Engine_get_total_state(engine);
+	size_t i;
+
+	open_entry(trace_ctl, TRACE_ENTRY_ENGINE);
+	put_u32(trace_ctl, HTS_Engine_get_sampling_frequency(engine));
+	put_u32(trace_ctl, HTS_Engine_get_fperiod(engine));
+	put_u32(trace_ctl, HTS_Engine_get_nstate(engine));
+	put_u32(trace_ctl, nr_states);
+	for (i = 0; i < nr_states; i++)
+		put_u32(trace_ctl, HTS_Engine_get_state_duration(engine, i));
+	close_entry(trace_ctl);
+
+	put_information(trace_ctl, engine);
+}
+
+void trace_commit(trace_handle_t trace_h)
+{
+	trace_ctl_t *trace_ctl = trace_h;
+	size_t len = trace_ctl->rec_len;
+	size_t wr, first;
+
+	if (trace_ctl->overflow) {
+		trace_ctl->dropped++;
+		return;
+	}
+	put_u32_at(trace_ctl->rec, len);
+
+	pthread_mutex_lock(&trace_ctl->lock);
+	if (TRACE_RING_SIZE - trace_ctl->count < len) {
+		pthread_mutex_unlock(&trace_ctl->lock);
+		trace_ctl->dropped++;
+		return;
+	}
+	wr = (trace_ctl->rd + trace_ctl->count) % TRACE_RING_SIZE;
+	first = TRACE_RING_SIZE - wr;
+	if (first > len)
+		first = len;
+	memcpy(trace_ctl->ring + wr, trace_ctl->rec, first);
+	memcpy(trace_ctl->ring, trace_ctl->rec + first, len - first);
+	trace_ctl->count += len;
+	pthread_cond_signal(&trace_ctl->cond);
+	pthread_mutex_unlock(&trace_ctl->lock);
+}
+
+int trace_check_header(FILE *fp)
+{
+	unsigned char hdr[8];
+
+	if (fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr) ||
+	    memcmp(hdr, TRACE_MAGIC, 4)) {
+		app_error("not a trace file.\n");
+		return -1;
+	}
+	if (get_u32(hdr + 4) != TRACE_VERSION) {
+		app_error("unsupported trace version %u.\n", get_u32(hdr + 4));
+		return -1;
+	}
+	return 0;
+}
+
+/* *rec is (re)allocated to hold the record.  returns 0 at end of file */
+int trace_read_record(FILE *fp, unsigned char **rec, size_t *len)
+{
+	unsigned char hdr[4];
+	unsigned char *p;
+	size_t n;
+
+	if (fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr))
+		return 0;
+	n = get_u32(hdr);
+	if (n < 8 || n > TRACE_REC_SIZE) {
+		app_error("broken trace record.\n");
+		return -1;
+	}
+	p = realloc(*rec, n);
+	if (p == NULL)
+		return -1;
+	memcpy(p, hdr, sizeof(hdr));
+	if (fread(p + sizeof(hdr), 1, n - sizeof(hdr), fp) !=
+	    n - sizeof(hdr)) {
+		app_error("truncated trace record.\n");
+		*rec = p;
+		return -1;
+	}
+	*rec = p;
+	*len = n;
+	return 1;
+}
+
+static void print_njd(FILE *fp, const unsigned char *p,
+		      const unsigned char *end)
+{
+	char s[10][TRACE_MAXSTRLEN];
+	char chain_rule[TRACE_MAXSTRLEN];
+	unsigned int nr_nodes, i, j;
+	int acc, mora_size, chain_flag;
+
+	if (end - p < 4)
+		return;
+	nr_nodes = get_u32(p);
+	p += 4;
+	for (i = 0; i < nr_nodes && p < end; i++) {
+		for (j = 0; j < 10; j++)
+			p += get_str(p, end, s[j], sizeof(s[j]));
+		if (end - p < 8)
+			break;
+		acc = get_u32(p);
+		mora_size = get_u32(p + 4);
+		p += 8;
+		p += get_str(p, end, chain_rule, sizeof(chain_rule));
+		if (end - p < 4)
+			break;
+		chain_flag = get_u32(p);
+		p += 4;
+		/* same as NJD_fprint() */
+		fprintf(fp, "%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%d/%d,%s,%d\n",
+			s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7], s[8],
+			s[9], acc, mora_size, chain_rule, chain_flag);
+	}
+}
+
+static void print_label(FILE *fp, const unsigned char *p,
+			const unsigned char *end, const unsigned char *eng)
+{
+	char label[TRACE_MAXSTRLEN * 4];
+	unsigned int nr_labels, i, j;
+	unsigned int nstate = 0, nr_states = 0, state = 0;
+	unsigned long frame = 0, duration;
+	double rate = 0.0;
+
+	if (eng != NULL) {
+		rate = get_u32(eng + 4) * 1.0e+07 / get_u32(eng);
+		nstate = get_u32(eng + 8);
+		nr_states = get_u32(eng + 12);
+		eng += 16;
+	}
+
+	if (end - p < 4)
+		return;
+	nr_labels = get_u32(p);
+	p += 4;
+	for (i = 0; i < nr_labels && p < end; i++) {
+		p += get_str(p, end, label, sizeof(label));
+		if (nstate == 0 || state + nstate > nr_states) {
+			fprintf(fp, "%s\n", label);
+			continue;
+		}
+		/* same as HTS_Engine_save_label() */
+		for (j = 0, duration = 0; j < nstate; j++)
+			duration += get_u32(eng + 4 * state++);
+		fprintf(fp, "%lu %lu %s\n", (unsigned long)(frame * rate),
+			(unsigned long)((frame + duration) * rate), label);
+		frame += duration;
+	}
+}
+
+static void print_engine(FILE *fp, const unsigned char *p)
+{
+	unsigned int nr_states = get_u32(p + 12);
+	unsigned long frames = 0;
+	unsigned int i;
+
+	for (i = 0; i < nr_states; i++)
+		frames += get_u32(p + 16 + 4 * i);
+
+	fprintf(fp, "[Global parameter]\n");
+	fprintf(fp, "Sampling frequency                     -> %8u(Hz)\n",
+		get_u32(p));
+	fprintf(fp, "Frame period                           -> %8u(point)\n",
+		get_u32(p + 4));
+	fprintf(fp, "Number of states                       -> %8u\n",
+		get_u32(p + 8));
+	fprintf(fp, "Total frames                           -> %8lu\n",
+		frames);
+}
+
+void trace_print_record(FILE *fp, const unsigned char *rec, size_t len)
+{
+	const unsigned char *end = rec + len;
+	const unsigned char *p = rec + 8;
+	const unsigned char *entry[TRACE_ENTRY_INFO + 1] = { NULL };
+	const unsigned char *entry_end[TRACE_ENTRY_INFO + 1] = { NULL };
+	char txt[TRACE_MAXSTRLEN * 4];
+	const unsigned char *eng;
+	unsigned int n;
+
+	while (end - p >= 5) {
+		n = get_u32(p + 1);
+		if ((size_t)(end - p - 5) < n)
+			break;
+		if (p[0] >= TRACE_ENTRY_TEXT && p[0] <= TRACE_ENTRY_INFO) {
+			entry[p[0]] = p + 5;
+			entry_end[p[0]] = p + 5 + n;
+		}
+		p += 5 + n;
+	}
+
+	/* durations are used only if the entry is consistent */
+	eng = entry[TRACE_ENTRY_ENGINE];
+	if (eng != NULL && (entry_end[TRACE_ENTRY_ENGINE] - eng < 16 ||
+			    (size_t)(entry_end[TRACE_ENTRY_ENGINE] - eng - 16) / 4 <
+			    get_u32(eng + 12) || get_u32(eng) == 0))
+		eng = NULL;
+
+	if (entry[TRACE_ENTRY_TEXT] != NULL) {
+		get_str(entry[TRACE_ENTRY_TEXT], entry_end[TRACE_ENTRY_TEXT],
+			txt, sizeof(txt));
+		fprintf(fp, "[Input text %u]\n%s\n", get_u32(rec + 4), txt);
+	}
+	if (entry[TRACE_ENTRY_NJD] != NULL) {
+		fprintf(fp, "[Text analysis result]\n");
+		print_njd(fp, entry[TRACE_ENTRY_NJD],
+			  entry_end[TRACE_ENTRY_NJD]);
+	}
+	if (entry[TRACE_ENTRY_LABEL] != NULL) {
+		fprintf(fp, "\n[Output label]\n");
+		print_label(fp, entry[TRACE_ENTRY_LABEL],
+			    entry_end[TRACE_ENTRY_LABEL], eng);
+	}
+	if (entry[TRACE_ENTRY_INFO] != NULL) {
+		fprintf(fp, "\n");
+		fwrite(entry[TRACE_ENTRY_INFO], 1,
+		       entry_end[TRACE_ENTRY_INFO] - entry[TRACE_ENTRY_INFO], fp);
+	} else if (eng != NULL) {
+		/* records without the engine information */
+		fprintf(fp, "\n");
+		print_engine(fp, eng);
+	}
+	fprintf(fp, "\n");
+}
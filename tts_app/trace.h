@@ -0,0 +1,31 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdio.h>
+
+#include "njd.h"
+#include "HTS_engine.h"
+
+typedef struct trace_ctl *trace_handle_t;
+
+typedef enum {
+	TRACE_FORMAT_TEXT,
+	TRACE_FORMAT_BINARY,
+} trace_format_t;
+
+/* capture, called on the synthesis thread */
+extern trace_handle_t trace_init(FILE *fp, trace_format_t format);
+extern void trace_exit(trace_handle_t trace_h);
+extern void trace_begin(trace_handle_t trace_h, const char *txt);
+extern void trace_njd(trace_handle_t trace_h, NJD *njd);
+extern void trace_label(trace_handle_t trace_h, char **label, int label_size);
+extern void trace_engine(trace_handle_t trace_h, HTS_Engine *engine);
+extern void trace_commit(trace_handle_t trace_h);
+
+/* decoding, shared with trace_dump */
+extern int trace_check_header(FILE *fp);
+extern int trace_read_record(FILE *fp, unsigned char **rec, size_t *len);
+extern void trace_print_record(FILE *fp, const unsigned char *rec,
+			       size_t len);
+
+#endif	/* _TRACE_H */
@@ -0,0 +1,70 @@
+/*
+ *  Copyright (c) Toshihiro Kobayashi <kobacha@mwa.biglobe.ne.jp>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* trace_dump: decode a binary trace (tts_app -otb) into text */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "trace.h"
+#include "debug.h"
+
+int main(int argc, char **argv)
+{
+	FILE *fp = stdin;
+	unsigned char *rec = NULL;
+	size_t len;
+	int r, ret = 0;
+
+	if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+		fprintf(stderr, "usage: trace_dump [ tracefile ]\n");
+		return 1;
+	}
+	if (argc == 2 && (fp = fopen(argv[1], "rb")) == NULL) {
+		app_error("Cannot open %s.\n", argv[1]);
+		return 1;
+	}
+
+	if (trace_check_header(fp) < 0) {
+		ret = 1;
+		goto out;
+	}
+	while ((r = trace_read_record(fp, &rec, &len)) > 0)
+		trace_print_record(stdout, rec, len);
+	if (r < 0)
+		ret = 1;
+
+out:
+	free(rec);
+	if (fp != stdin)
+		fclose(fp);
+
+	return ret;
+}
@@ -0,0 +1,1004 @@
+/*
+ *  Copyright (c) Toshihiro Kobayashi <kobacha@mwa.biglobe.ne.jp>
+ *
+ *  this is based on open_jtalk.c from open_jtalk-1.05
+ *  http://open-jtalk.sourceforge.net/
+ *  Copyright (c) 2008-2012  Nagoya Institute of Technology
+ *                           Department of Computer Science
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ * - Neither the name of the HTS working group nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Text-to-speech library.
+ *
+ * Everything one synthesis pipeline needs lives in a tts_ctl, so a host
+ * may keep several of them in one process.  Errors are returned as
+ * negated TTS_ERR_* codes; nothing here terminates the process.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "mecab.h"
+#include "njd.h"
+#include "jpcommon.h"
+#include "HTS_engine.h"
+
+#include "text2mecab.h"
+#include "mecab2njd.h"
+#include "njd_set_pronunciation.h"
+#include "njd_set_digit.h"
+#include "njd_set_accent_phrase.h"
+#include "njd_set_accent_type.h"
+#include "njd_set_unvoiced_vowel.h"
+#include "njd_set_long_vowel.h"
+#include "njd2jpcommon.h"
+
+#include "tts.h"
+#include "play.h"
+#include "mixer.h"
+#include "psynth.h"
+#include "trace.h"
+#include "label_io.h"
+#include "silence.h"
+#include "template.h"
+#ifndef DEBUG_LEVEL_TTS
+#define DEBUG_LEVEL_TTS	0
+#endif
+#define DEBUG_HEAD_TTS	"[tts] "
+
+#include "debug.h"
+
+#define MAXBUFLEN 1024
+
+/* cross-fade at the joints of parallel synthesis */
+#define PSYNTH_XFADE_MS	5
+/* cross-fade between carrier segments and slots */
+#define TEMPLATE_XFADE_MS	5
+
+typedef struct tts_ctl {
+	tts_param_t param;
+
+	Mecab mecab;
+	NJD njd;
+	JPCommon jpcommon;
+	HTS_Engine engine;
+	HTS_BandWork band_work;	/* parameter generation, kept for reuse */
+	int model_compacted;
+	psynth_handle_t psynth_h;
+	trace_handle_t trace_h;
+	template_handle_t template_h;
+
+	/* last utterance, chunks handed to the callback point into it */
+	short *pcm;
+
+	play_handle_t play_h;
+	play_info_t play_info;
+	mixer_handle_t mixer_h;
+	mixer_stream_t stream;	/* own source, kept across utterances */
+	mixer_stream_t source;	/* of tts_synthesize_source(), or NULL */
+
+	tts_stat_t stat;
+
+	/* set by the first startup step that fails */
+	pthread_mutex_t startup_lock;
+	int startup_failed;
+	double startup_base_ms;
+} tts_ctl_t;
+
+typedef struct tts_step {
+	tts_ctl_t *tts_ctl;
+	int (*func)(tts_ctl_t *tts_ctl);
+	int id;
+	int r;
+	int threaded;
+	pthread_t thread;
+} tts_step_t;
+
+/* MeCab keeps its last error in a process-wide string */
+static pthread_mutex_t tts_load_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void tts_param_init(tts_param_t *param)
+{
+	memset(param, 0, sizeof(*param));
+	param->trace_format = TRACE_FORMAT_TEXT;
+	param->sampling_rate = 48000;
+	param->fperiod = -1;
+	param->alpha = -1.0;
+	param->beta = -1.0;
+	param->half_tone = -1.0;
+	param->uv_threshold = -1.0;
+	param->gv_weight_mgc = -1.0;
+	param->gv_weight_lf0 = -1.0;
+#ifdef HTS_MELP
+	param->gv_weight_lpf = -1.0;
+#endif	/* HTS_MELP */
+	param->speed = -1.0;
+	param->nr_jobs = 1;
+	param->trim_ms = -1;
+	param->mixer_gain = 1.0;
+}
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* the steps cannot be interrupted, but skip what is left of them */
+static int startup_canceled(tts_ctl_t *tts_ctl)
+{
+	int failed;
+
+	pthread_mutex_lock(&tts_ctl->startup_lock);
+	failed = tts_ctl->startup_failed;
+	pthread_mutex_unlock(&tts_ctl->startup_lock);
+
+	return failed;
+}
+
+static int open_audio(tts_ctl_t *tts_ctl)
+{
+	const tts_param_t *param = &tts_ctl->param;
+
+	tts_ctl->play_h = play_init(&tts_ctl->play_info, param->pcm_name,
+				    SND_PCM_FORMAT_S16_LE, 1,
+				    param->sampling_rate, 500000, 8);
+	if (tts_ctl->play_h == NULL)
+		return -TTS_ERR_AUDIO;
+	if (param->use_mixer && !startup_canceled(tts_ctl)) {
+		tts_ctl->mixer_h = mixer_init(tts_ctl->play_h,
+					      &tts_ctl->play_info);
+		if (tts_ctl->mixer_h == NULL)
+			return -TTS_ERR_AUDIO;
+		tts_ctl->stream = mixer_open(tts_ctl->mixer_h,
+					     param->mixer_gain,
+					     param->mixer_priority);
+		if (tts_ctl->stream == NULL)
+			return -TTS_ERR_NOMEM;
+	}
+
+	return TTS_OK;
+}
+
+static int load_dic(tts_ctl_t *tts_ctl)
+{
+	int r = TTS_OK;
+
+	pthread_mutex_lock(&tts_load_lock);
+	if (startup_canceled(tts_ctl))
+		r = -TTS_ERR_ABORTED;
+	else if (Mecab_load(&tts_ctl->mecab,
+			    tts_ctl->param.dn_mecab) != TRUE)
+		r = -TTS_ERR_DIC;
+	pthread_mutex_unlock(&tts_load_lock);
+
+	return r;
+}
+
+static int load_voice(tts_ctl_t *tts_ctl)
+{
+#ifdef HTS_MELP
+#define NR_STREAMS	3
+#else
+#define NR_STREAMS	2
+#endif	/* HTS_MELP */
+	const tts_param_t *param = &tts_ctl->param;
+	HTS_Engine *engine = &tts_ctl->engine;
+	double gv_weight[] = {
+		param->gv_weight_mgc,
+		param->gv_weight_lf0,
+#ifdef HTS_MELP
+		param->gv_weight_lpf
+#endif	/* HTS_MELP */
+	};
+	char *fn_voice = (char *)param->fn_voice;
+	int i;
+
+	if (HTS_Engine_load(engine, &fn_voice, 1) != TRUE)
+		return -TTS_ERR_VOICE;
+	if (startup_canceled(tts_ctl))
+		return -TTS_ERR_ABORTED;
+	if (param->compact_model) {
+		HTS_Engine_compact_model(engine, &tts_ctl->stat.model_bytes,
+					 &tts_ctl->stat.model_compact_bytes);
+		tts_ctl->model_compacted = 1;
+	}
+	HTS_Engine_set_sampling_frequency(engine,
+					  (size_t)param->sampling_rate);
+	if (param->fperiod >= 0)
+		HTS_Engine_set_fperiod(engine, param->fperiod);
+	if (param->alpha >= 0.0)
+		HTS_Engine_set_alpha(engine, param->alpha);
+	if (param->beta >= 0.0)
+		HTS_Engine_set_beta(engine, param->beta);
+	if (param->half_tone >= 0.0)
+		HTS_Engine_add_half_tone(engine, param->half_tone);
+	if (param->audio_buff_size > 0)
+		HTS_Engine_set_audio_buff_size(engine,
+					       param->audio_buff_size);
+	if (param->uv_threshold >= 0.0)
+		HTS_Engine_set_msd_threshold(engine, 1, param->uv_threshold);
+	if (param->speed >= 0.0)
+		HTS_Engine_set_speed(engine, param->speed);
+	for (i = 0; i < NR_STREAMS; i++)
+		if (gv_weight[i] >= 0.0)
+			HTS_Engine_set_gv_weight(engine, i, gv_weight[i]);
+
+	/* job engines copy the parameters set above */
+	if (param->nr_jobs > 1 && !startup_canceled(tts_ctl)) {
+		tts_ctl->psynth_h = psynth_init(engine, param->nr_jobs,
+				(size_t)param->sampling_rate *
+				PSYNTH_XFADE_MS / 1000);
+		if (tts_ctl->psynth_h == NULL)
+			return -TTS_ERR_NOMEM;
+	}
+
+	return TTS_OK;
+}
+
+static void *step_thread(void *arg)
+{
+	tts_step_t *step = arg;
+	tts_ctl_t *tts_ctl = step->tts_ctl;
+	tts_stat_t *stat = &tts_ctl->stat;
+
+	stat->step[step->id].begin_ms = now_ms() - tts_ctl->startup_base_ms;
+	step->r = step->func(tts_ctl);
+	stat->step[step->id].end_ms = now_ms() - tts_ctl->startup_base_ms;
+	if (step->r < 0) {
+		pthread_mutex_lock(&tts_ctl->startup_lock);
+		tts_ctl->startup_failed = 1;
+		pthread_mutex_unlock(&tts_ctl->startup_lock);
+	}
+
+	return NULL;
+}
+
+/*
+ * Returns the error of a failed step rather than TTS_ERR_ABORTED of
+ * those that gave up because of it.
+ */
+static int run_steps(tts_ctl_t *tts_ctl, tts_step_t *step, int nr_steps)
+{
+	int i, r = TTS_OK;
+
+	for (i = 0; i < nr_steps; i++) {
+		step[i].tts_ctl = tts_ctl;
+		/* the last step runs on the caller */
+		if (i < nr_steps - 1 &&
+		    pthread_create(&step[i].thread, NULL,
+				   step_thread, &step[i]) == 0)
+			step[i].threaded = 1;
+		else
+			step_thread(&step[i]);
+	}
+	for (i = 0; i < nr_steps; i++) {
+		if (step[i].threaded)
+			pthread_join(step[i].thread, NULL);
+		if (step[i].r < 0 &&
+		    (r == TTS_OK || r == -TTS_ERR_ABORTED))
+			r = step[i].r;
+	}
+	tts_ctl->stat.startup_ms = now_ms() - tts_ctl->startup_base_ms;
+
+	return r;
+}
+
+int tts_init(tts_handle_t *tts_h, const tts_param_t *param)
+{
+	tts_step_t step[TTS_NR_STEPS];
+	tts_ctl_t *tts_ctl;
+	int nr_steps = 0;
+	int i, r = TTS_OK;
+
+	app_debug(TTS, 3, "%s() in\n", __func__);
+	*tts_h = NULL;
+	if (param->sampling_rate <= 0 || param->nr_jobs < 1)
+		return -TTS_ERR_INVAL;
+	/* job engines would share the HTS audio buffer */
+	if (param->nr_jobs > 1 && param->audio_buff_size > 0)
+		return -TTS_ERR_INVAL;
+
+	tts_ctl = calloc(1, sizeof(tts_ctl_t));
+	if (tts_ctl == NULL)
+		return -TTS_ERR_NOMEM;
+	tts_ctl->param = *param;
+	tts_ctl->startup_base_ms = now_ms();
+	pthread_mutex_init(&tts_ctl->startup_lock, NULL);
+	memset(step, 0, sizeof(step));
+	for (i = 0; i < TTS_NR_STEPS; i++) {
+		tts_ctl->stat.step[i].begin_ms = -1.0;
+		tts_ctl->stat.step[i].end_ms = -1.0;
+	}
+
+	/* none of these fail, so tts_exit() can always clear them */
+	Mecab_initialize(&tts_ctl->mecab);
+	NJD_initialize(&tts_ctl->njd);
+	JPCommon_initialize(&tts_ctl->jpcommon);
+	HTS_Engine_initialize(&tts_ctl->engine);
+	HTS_BandWork_initialize(&tts_ctl->band_work);
+
+	if (param->logfp != NULL) {
+		tts_ctl->trace_h = trace_init(param->logfp,
+					      param->trace_format);
+		if (tts_ctl->trace_h == NULL) {
+			r = -TTS_ERR_NOMEM;
+			goto err;
+		}
+	}
+
+	/* independent steps, run on their own threads */
+	if (param->pcm_name != NULL && param->fn_voice != NULL) {
+		step[nr_steps].id = TTS_STEP_AUDIO;
+		step[nr_steps++].func = open_audio;
+	}
+	if (param->dn_mecab != NULL) {
+		step[nr_steps].id = TTS_STEP_DIC;
+		step[nr_steps++].func = load_dic;
+	}
+	if (param->fn_voice != NULL) {
+		step[nr_steps].id = TTS_STEP_VOICE;
+		step[nr_steps++].func = load_voice;
+	}
+	r = run_steps(tts_ctl, step, nr_steps);
+	if (r < 0)
+		goto err;
+
+	*tts_h = tts_ctl;
+	app_debug(TTS, 3, "%s() out\n", __func__);
+	return TTS_OK;
+
+err:
+	tts_exit(tts_ctl);
+	return r;
+}
+
+void tts_exit(tts_handle_t tts_h)
+{
+	tts_ctl_t *tts_ctl = tts_h;
+
+	app_debug(TTS, 3, "%s() in\n", __func__);
+	if (tts_ctl->template_h != NULL)
+		template_exit(tts_ctl->template_h);
+	if (tts_ctl->psynth_h != NULL)
+		psynth_exit(tts_ctl->psynth_h);
+	if (tts_ctl->trace_h != NULL)
+		trace_exit(tts_ctl->trace_h);
+	Mecab_clear(&tts_ctl->mecab);
+	NJD_clear(&tts_ctl->njd);
+	JPCommon_clear(&tts_ctl->jpcommon);
+	if (tts_ctl->model_compacted)
+		HTS_Engine_clear_compact_model(&tts_ctl->engine);
+	HTS_Engine_clear(&tts_ctl->engine);
+	HTS_BandWork_clear(&tts_ctl->band_work);
+	/* the own source is closed and played out here */
+	if (tts_ctl->mixer_h != NULL)
+		mixer_exit(tts_ctl->mixer_h);
+	if (tts_ctl->play_h != NULL) {
+		play_drain(tts_ctl->play_h);
+		play_exit(tts_ctl->play_h);
+	}
+	free(tts_ctl->pcm);
+	pthread_mutex_destroy(&tts_ctl->startup_lock);
+	free(tts_ctl);
+	app_debug(TTS, 3, "%s() out\n", __func__);
+}
+
+static int deliver(tts_ctl_t *tts_ctl, const short *pcm, size_t pcm_len,
+		   tts_pcm_cb_t cb, void *arg)
+{
+	mixer_stream_t stream;
+	ssize_t r;
+
+	if (cb != NULL) {
+		size_t chunk_len = tts_ctl->param.chunk_len;
+		size_t off, len;
+
+		if (chunk_len == 0)
+			chunk_len = pcm_len;
+		for (off = 0; off < pcm_len; off += len) {
+			len = pcm_len - off;
+			if (len > chunk_len)
+				len = chunk_len;
+			if (cb(pcm + off, len, arg) < 0)
+				return -TTS_ERR_CANCELED;
+		}
+		return TTS_OK;
+	}
+
+	if (tts_ctl->play_h == NULL)
+		return -TTS_ERR_INVAL;
+	if (tts_ctl->mixer_h == NULL) {
+		r = play_write(tts_ctl->play_h, (void *)pcm,
+			       pcm_len * sizeof(short));
+		return (r < 0) ? -TTS_ERR_AUDIO : TTS_OK;
+	}
+
+	/*
+	 * queued behind the previous utterances of the source, whose tail
+	 * keeps playing while the next one is synthesized
+	 */
+	stream = (tts_ctl->source != NULL) ? tts_ctl->source : tts_ctl->stream;
+	r = mixer_write(stream, pcm, pcm_len * sizeof(short));
+	if (r < 0)
+		return -TTS_ERR_AUDIO;
+	mixer_flush(stream);
+
+	return TTS_OK;
+}
+
+/* samples of the leading and trailing silence */
+static void silence_edges(tts_ctl_t *tts_ctl, char **label, int label_size,
+			  const short *pcm, size_t pcm_len,
+			  size_t *lead, size_t *trail)
+{
+	int rate = tts_ctl->param.sampling_rate;
+
+	if (tts_ctl->psynth_h == NULL) {
+		*lead = silence_label_len(&tts_ctl->engine,
+					  label, label_size, 0);
+		*trail = silence_label_len(&tts_ctl->engine,
+					   label, label_size, 1);
+	} else {
+		/* job engines hold no state durations */
+		*lead = silence_scan(pcm, pcm_len, rate, 0);
+		*trail = silence_scan(pcm, pcm_len, rate, 1);
+	}
+	if (*lead >= pcm_len)
+		*lead = *trail = 0;	/* nothing but silence */
+	else if (*trail > pcm_len - *lead)
+		*trail = pcm_len - *lead;
+}
+
+/*
+ * Drop the leading silence so that the first sample delivered is speech,
+ * and cap the trailing one.  Returns the offset of the first sample kept.
+ */
+static size_t trim_silence(tts_ctl_t *tts_ctl, char **label, int label_size,
+			   const short *pcm, size_t *pcm_len)
+{
+	int rate = tts_ctl->param.sampling_rate;
+	size_t cap = (size_t)rate * tts_ctl->param.trim_ms / 1000;
+	size_t lead, trail;
+
+	silence_edges(tts_ctl, label, label_size, pcm, *pcm_len,
+		      &lead, &trail);
+	trail = (trail > cap) ? trail - cap : 0;
+	*pcm_len -= lead + trail;
+
+	tts_ctl->stat.lead_trimmed_ms = lead * 1000 / rate;
+	tts_ctl->stat.trail_trimmed_ms = trail * 1000 / rate;
+
+	return lead;
+}
+
+/*
+ * Labels to PCM.  The engine keeps the state durations until
+ * HTS_Engine_refresh().
+ */
+static short *render(tts_ctl_t *tts_ctl, char **label, int label_size,
+		     size_t *pcm_len)
+{
+	short *pcm;
+
+	if (tts_ctl->psynth_h != NULL)
+		return psynth_synthesize(tts_ctl->psynth_h,
+					 label, label_size, pcm_len);
+
+	if (HTS_Engine_synthesize_from_strings_banded(&tts_ctl->engine,
+			label, label_size, &tts_ctl->band_work) != TRUE)
+		return NULL;
+	*pcm_len = HTS_Engine_get_generated_speech_size(&tts_ctl->engine);
+	pcm = malloc(*pcm_len * sizeof(short));
+	if (pcm != NULL)
+		HTS_Engine_get_generated_speech(&tts_ctl->engine, pcm);
+
+	return pcm;
+}
+
+static void trace_back_end(tts_ctl_t *tts_ctl, char **label, int label_size,
+			   int rendered)
+{
+	/* formatted and written by the trace thread */
+	if (tts_ctl->trace_h != NULL) {
+		trace_label(tts_ctl->trace_h, label, label_size);
+		/* job engines hold no state durations */
+		if (tts_ctl->psynth_h == NULL && rendered)
+			trace_engine(tts_ctl->trace_h, &tts_ctl->engine);
+	}
+}
+
+/* back end: labels to speech */
+static int back_end(tts_ctl_t *tts_ctl, char **label, int label_size,
+		    tts_pcm_cb_t cb, void *arg)
+{
+	size_t pcm_len = 0;
+	size_t offset = 0;
+	int r = -TTS_ERR_SYNTH;
+
+	free(tts_ctl->pcm);
+	tts_ctl->stat.lead_trimmed_ms = 0;
+	tts_ctl->stat.trail_trimmed_ms = 0;
+
+	tts_ctl->pcm = render(tts_ctl, label, label_size, &pcm_len);
+	if (tts_ctl->pcm != NULL) {
+		if (tts_ctl->param.trim_ms >= 0)
+			offset = trim_silence(tts_ctl, label, label_size,
+					      tts_ctl->pcm, &pcm_len);
+		r = deliver(tts_ctl, tts_ctl->pcm + offset, pcm_len, cb, arg);
+	}
+	trace_back_end(tts_ctl, label, label_size, tts_ctl->pcm != NULL);
+	HTS_Engine_refresh(&tts_ctl->engine);
+
+	return r;
+}
+
+/* front end: text to labels, valid until front_end_refresh() */
+static int front_end(tts_ctl_t *tts_ctl, const char *txt, char ***label)
+{
+	char buff[MAXBUFLEN];
+	int label_size;
+
+	text2mecab(buff, txt);
+	Mecab_analysis(&tts_ctl->mecab, buff);
+	mecab2njd(&tts_ctl->njd, Mecab_get_feature(&tts_ctl->mecab),
+		  Mecab_get_size(&tts_ctl->mecab));
+	njd_set_pronunciation(&tts_ctl->njd);
+	njd_set_digit(&tts_ctl->njd);
+	njd_set_accent_phrase(&tts_ctl->njd);
+	njd_set_accent_type(&tts_ctl->njd);
+	njd_set_unvoiced_vowel(&tts_ctl->njd);
+	njd_set_long_vowel(&tts_ctl->njd);
+	njd2jpcommon(&tts_ctl->jpcommon, &tts_ctl->njd);
+	JPCommon_make_label(&tts_ctl->jpcommon);
+	label_size = JPCommon_get_label_size(&tts_ctl->jpcommon);
+	*label = JPCommon_get_label_feature(&tts_ctl->jpcommon);
+
+	return label_size;
+}
+
+static void front_end_refresh(tts_ctl_t *tts_ctl)
+{
+	JPCommon_refresh(&tts_ctl->jpcommon);
+	NJD_refresh(&tts_ctl->njd);
+	Mecab_refresh(&tts_ctl->mecab);
+}
+
+int tts_synthesize(tts_handle_t tts_h, const char *txt,
+		   tts_pcm_cb_t cb, void *arg)
+{
+	tts_ctl_t *tts_ctl = tts_h;
+	char **label;
+	int label_size;
+	int r = -TTS_ERR_SYNTH;
+
+	if (tts_ctl->param.dn_mecab == NULL ||
+	    tts_ctl->param.fn_voice == NULL)
+		return -TTS_ERR_INVAL;
+
+	if (tts_ctl->trace_h != NULL)
+		trace_begin(tts_ctl->trace_h, txt);
+	label_size = front_end(tts_ctl, txt, &label);
+	if (label_size > 2) {
+		if (tts_ctl->trace_h != NULL)
+			trace_njd(tts_ctl->trace_h, &tts_ctl->njd);
+		r = back_end(tts_ctl, label, label_size, cb, arg);
+	}
+	if (tts_ctl->trace_h != NULL)
+		trace_commit(tts_ctl->trace_h);
+	front_end_refresh(tts_ctl);
+
+	return r;
+}
+
+int tts_synthesize_label(tts_handle_t tts_h, char **label, int label_size,
+			 tts_pcm_cb_t cb, void *arg)
+{
+	tts_ctl_t *tts_ctl = tts_h;
+	int r;
+
+	if (tts_ctl->param.fn_voice == NULL)
+		return -TTS_ERR_INVAL;
+	if (label_size <= 2)
+		return -TTS_ERR_SYNTH;
+
+	if (tts_ctl->trace_h != NULL)
+		trace_begin(tts_ctl->trace_h, "");
+	r = back_end(tts_ctl, label, label_size, cb, arg);
+	if (tts_ctl->trace_h != NULL)
+		trace_commit(tts_ctl->trace_h);
+
+	return r;
+}
+
+struct tts_source {
+	mixer_stream_t stream;
+};
+
+int tts_source_open(tts_handle_t tts_h, double gain, int priority,
+		    tts_source_t *src)
+{
+	tts_ctl_t *tts_ctl = tts_h;
+	tts_source_t s;
+
+	if (tts_ctl->mixer_h == NULL)
+		return -TTS_ERR_INVAL;
+	s = malloc(sizeof(*s));
+	if (s == NULL)
+		return -TTS_ERR_NOMEM;
+	s->stream = mixer_open(tts_ctl->mixer_h, gain, priority);
+	if (s->stream == NULL) {
+		free(s);
+		return -TTS_ERR_NOMEM;
+	}
+	*src = s;
+
+	return TTS_OK;
+}
+
+/* what is queued on the source is still played */
+void tts_source_close(tts_source_t src)
+{
+	mixer_close(src->stream);
+	free(src);
+}
+
+int tts_synthesize_source(tts_handle_t tts_h, tts_source_t src,
+			  const char *txt)
+{
+	tts_ctl_t *tts_ctl = tts_h;
+	int r;
+
+	if (tts_ctl->mixer_h == NULL)
+		return -TTS_ERR_INVAL;
+	tts_ctl->source = src->stream;
+	r = tts_synthesize(tts_h, txt, NULL, NULL);
+	tts_ctl->source = NULL;
+
+	return r;
+}
+
+int tts_write_label(tts_handle_t tts_h, const char *txt, FILE *fp)
+{
+	tts_ctl_t *tts_ctl = tts_h;
+	char **label;
+	int label_size;
+	int r = -TTS_ERR_SYNTH;
+
+	if (tts_ctl->param.dn_mecab == NULL)
+		return -TTS_ERR_INVAL;
+
+	if (tts_ctl->trace_h != NULL)
+		trace_begin(tts_ctl->trace_h, txt);
+	label_size = front_end(tts_ctl, txt, &label);
+	if (label_size > 2) {
+		if (tts_ctl->trace_h != NULL)
+			trace_njd(tts_ctl->trace_h, &tts_ctl->njd);
+		r = (label_write(fp, label, label_size) < 0) ?
+			-TTS_ERR_IO : TTS_OK;
+		if (tts_ctl->trace_h != NULL)
+			trace_label(tts_ctl->trace_h, label, label_size);
+	}
+	if (tts_ctl->trace_h != NULL)
+		trace_commit(tts_ctl->trace_h);
+	front_end_refresh(tts_ctl);
+
+	return r;
+}
+
+static void free_label(char **label, int label_size)
+{
+	int i;
+
+	for (i = 0; i < label_size; i++)
+		free(label[i]);
+	free(label);
+}
+
+/* copy of labels that outlives front_end_refresh() */
+static char **dup_label(char **label, int label_size)
+{
+	char **dup = calloc(label_size, sizeof(char *));
+	int i;
+
+	if (dup == NULL)
+		return NULL;
+	for (i = 0; i < label_size; i++) {
+		dup[i] = strdup(label[i]);
+		if (dup[i] == NULL) {
+			free_label(dup, i);
+			return NULL;
+		}
+	}
+
+	return dup;
+}
+
+/*
+ * Cut the carrier segments out of the samples of the whole template;
+ * slot[i] spans the labels start[i]..end[i]-1.
+ */
+static template_piece_t *cut_carrier(tts_ctl_t *tts_ctl, int nr_slots,
+				     const int *start, const int *end,
+				     const short *pcm, size_t pcm_len)
+{
+	size_t margin = (size_t)tts_ctl->param.sampling_rate *
+			TEMPLATE_XFADE_MS / 1000 / 2;
+	template_piece_t *carrier;
+	int i;
+
+	carrier = calloc(nr_slots + 1, sizeof(template_piece_t));
+	if (carrier == NULL)
+		return NULL;
+	for (i = 0; i <= nr_slots; i++) {
+		template_piece_t *c = &carrier[i];
+		size_t from = (i == 0) ? 0 :
+			template_label_offset(&tts_ctl->engine, end[i - 1]);
+		size_t to = (i == nr_slots) ? pcm_len :
+			template_label_offset(&tts_ctl->engine, start[i]);
+
+		if (to > pcm_len)
+			to = pcm_len;
+		if (from > to)
+			from = to;
+		c->head = (i == 0) ? 0 : (from < margin) ? from : margin;
+		c->core = to - from;
+		c->tail = (i == nr_slots) ? 0 :
+			  (pcm_len - to < margin) ? pcm_len - to : margin;
+		c->pcm = malloc((c->head + c->core + c->tail + 1) *
+				sizeof(short));
+		if (c->pcm == NULL)
+			goto err;
+		memcpy(c->pcm, pcm + from - c->head,
+		       (c->head + c->core + c->tail) * sizeof(short));
+	}
+
+	return carrier;
+
+err:
+	for (i = 0; i <= nr_slots; i++)
+		free(carrier[i].pcm);
+	free(carrier);
+	return NULL;
+}
+
+int tts_template_add(tts_handle_t tts_h, const char *tmpl)
+{
+	tts_ctl_t *tts_ctl = tts_h;
+	template_piece_t *carrier = NULL;
+	char *text = NULL, **filler = NULL;
+	char **label = NULL, **sub;
+	int *start = NULL, *end = NULL;
+	int nr_slots, label_size = 0, sub_size;
+	short *pcm = NULL;
+	size_t pcm_len;
+	int i, r = -TTS_ERR_NOMEM;
+
+	if (tts_ctl->param.dn_mecab == NULL ||
+	    tts_ctl->param.fn_voice == NULL)
+		return -TTS_ERR_INVAL;
+	if (tts_ctl->template_h == NULL) {
+		tts_ctl->template_h = template_init();
+		if (tts_ctl->template_h == NULL)
+			return -TTS_ERR_NOMEM;
+	}
+	nr_slots = template_parse(tmpl, &text, &filler);
+	if (nr_slots < 0)
+		return -TTS_ERR_INVAL;
+	start = calloc(nr_slots + 1, sizeof(int));
+	end = calloc(nr_slots + 1, sizeof(int));
+	if (start == NULL || end == NULL)
+		goto out;
+
+	/* the whole sentence, with the sample fillers in the slots */
+	label_size = front_end(tts_ctl, text, &sub);
+	label = dup_label(sub, label_size);
+	front_end_refresh(tts_ctl);
+	if (label == NULL)
+		goto out;
+
+	/* locate each filler by its phonemes */
+	r = -TTS_ERR_INVAL;
+	for (i = 0; i < nr_slots; i++) {
+		sub_size = front_end(tts_ctl, filler[i], &sub);
+		start[i] = template_find(label, label_size,
+					 (i == 0) ? 1 : end[i - 1],
+					 sub, sub_size);
+		end[i] = start[i] + sub_size - 2;
+		front_end_refresh(tts_ctl);
+		if (start[i] < 0) {
+			app_error("slot \"%s\" not found in \"%s\".\n",
+				  filler[i], text);
+			goto out;
+		}
+	}
+
+	/* the state durations tell where the fillers are */
+	r = -TTS_ERR_SYNTH;
+	if (HTS_Engine_synthesize_from_strings_banded(&tts_ctl->engine,
+			label, label_size, &tts_ctl->band_work) != TRUE)
+		goto refresh;
+	r = -TTS_ERR_NOMEM;
+	pcm_len = HTS_Engine_get_generated_speech_size(&tts_ctl->engine);
+	pcm = malloc(pcm_len * sizeof(short));
+	if (pcm == NULL)
+		goto refresh;
+	HTS_Engine_get_generated_speech(&tts_ctl->engine, pcm);
+	carrier = cut_carrier(tts_ctl, nr_slots, start, end, pcm, pcm_len);
+	if (carrier == NULL)
+		goto refresh;
+	r = template_add(tts_ctl->template_h, nr_slots, carrier);
+	if (r < 0) {
+		for (i = 0; i <= nr_slots; i++)
+			free(carrier[i].pcm);
+		free(carrier);
+		r = -TTS_ERR_NOMEM;
+	}
+
+refresh:
+	HTS_Engine_refresh(&tts_ctl->engine);
+out:
+	free(pcm);
+	if (label != NULL)
+		free_label(label, label_size);
+	free(start);
+	free(end);
+	template_free_filler(filler, nr_slots);
+	free(text);
+
+	return r;
+}
+
+/* one slot to PCM, trimmed to the cross-fade margin of its silences */
+static int render_slot(tts_ctl_t *tts_ctl, const char *txt,
+		       template_piece_t *slot)
+{
+	size_t margin = (size_t)tts_ctl->param.sampling_rate *
+			TEMPLATE_XFADE_MS / 1000 / 2;
+	size_t pcm_len = 0, lead, trail;
+	char **label;
+	int label_size;
+	int r = -TTS_ERR_SYNTH;
+
+	if (tts_ctl->trace_h != NULL)
+		trace_begin(tts_ctl->trace_h, txt);
+	label_size = front_end(tts_ctl, txt, &label);
+	if (label_size > 2) {
+		if (tts_ctl->trace_h != NULL)
+			trace_njd(tts_ctl->trace_h, &tts_ctl->njd);
+		slot->pcm = render(tts_ctl, label, label_size, &pcm_len);
+		if (slot->pcm != NULL) {
+			silence_edges(tts_ctl, label, label_size,
+				      slot->pcm, pcm_len, &lead, &trail);
+			slot->head = (lead < margin) ? lead : margin;
+			slot->core = pcm_len - lead - trail;
+			slot->tail = (trail < margin) ? trail : margin;
+			/* the margins are in front of and behind the core */
+			memmove(slot->pcm, slot->pcm + lead - slot->head,
+				(slot->head + slot->core + slot->tail) *
+				sizeof(short));
+			r = TTS_OK;
+		}
+		trace_back_end(tts_ctl, label, label_size, slot->pcm != NULL);
+		HTS_Engine_refresh(&tts_ctl->engine);
+	}
+	if (tts_ctl->trace_h != NULL)
+		trace_commit(tts_ctl->trace_h);
+	front_end_refresh(tts_ctl);
+
+	return r;
+}
+
+int tts_template_nr_slots(tts_handle_t tts_h, int id)
+{
+	tts_ctl_t *tts_ctl = tts_h;
+	int nr_slots;
+
+	if (tts_ctl->template_h == NULL)
+		return -TTS_ERR_INVAL;
+	nr_slots = template_nr_slots(tts_ctl->template_h, id);
+
+	return (nr_slots < 0) ? -TTS_ERR_INVAL : nr_slots;
+}
+
+int tts_template_synthesize(tts_handle_t tts_h, int id,
+			    const char * const *slot_txt,
+			    tts_pcm_cb_t cb, void *arg)
+{
+	tts_ctl_t *tts_ctl = tts_h;
+	template_piece_t *slot;
+	size_t pcm_len;
+	int nr_slots;
+	int i, r = TTS_OK;
+
+	if (tts_ctl->template_h == NULL)
+		return -TTS_ERR_INVAL;
+	nr_slots = template_nr_slots(tts_ctl->template_h, id);
+	if (nr_slots < 0)
+		return -TTS_ERR_INVAL;
+	slot = calloc(nr_slots + 1, sizeof(template_piece_t));
+	if (slot == NULL)
+		return -TTS_ERR_NOMEM;
+
+	/* only the slots go through the pipeline */
+	for (i = 0; i < nr_slots && r == TTS_OK; i++)
+		r = render_slot(tts_ctl, slot_txt[i], &slot[i]);
+	if (r == TTS_OK) {
+		free(tts_ctl->pcm);
+		tts_ctl->pcm = template_join(tts_ctl->template_h, id, slot,
+					     &pcm_len);
+		if (tts_ctl->pcm == NULL)
+			r = -TTS_ERR_NOMEM;
+		else
+			r = deliver(tts_ctl, tts_ctl->pcm, pcm_len, cb, arg);
+	}
+
+	for (i = 0; i < nr_slots; i++)
+		free(slot[i].pcm);
+	free(slot);
+
+	return r;
+}
+
+void tts_get_stat(tts_handle_t tts_h, tts_stat_t *stat)
+{
+	tts_ctl_t *tts_ctl = tts_h;
+
+	*stat = tts_ctl->stat;
+}
+
+const char *tts_strerror(int err)
+{
+	static const char * const msg[] = {
+		[TTS_OK] = "success",
+		[TTS_ERR_INVAL] = "invalid parameter",
+		[TTS_ERR_NOMEM] = "out of memory",
+		[TTS_ERR_DIC] = "cannot load dictionary",
+		[TTS_ERR_VOICE] = "cannot load HTS voice",
+		[TTS_ERR_AUDIO] = "audio device error",
+		[TTS_ERR_SYNTH] = "synthesis failed",
+		[TTS_ERR_IO] = "output error",
+		[TTS_ERR_CANCELED] = "canceled by the PCM callback",
+		[TTS_ERR_ABORTED] = "startup aborted",
+	};
+
+	if (err < 0)
+		err = -err;
+	if (err >= (int)(sizeof(msg) / sizeof(msg[0])))
+		return "unknown error";
+	return msg[err];
+}
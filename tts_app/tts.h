@@ -0,0 +1,128 @@
+#ifndef _TTS_H
+#define _TTS_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "trace.h"
+
+/*
+ * A context is used by one thread at a time.  Any number of contexts may
+ * be created, used and destroyed concurrently.
+ */
+typedef struct tts_ctl *tts_handle_t;
+
+/* error codes, returned negated */
+enum {
+	TTS_OK = 0,
+	TTS_ERR_INVAL,		/* invalid parameter or call in this mode */
+	TTS_ERR_NOMEM,		/* out of memory */
+	TTS_ERR_DIC,		/* cannot load the dictionary */
+	TTS_ERR_VOICE,		/* cannot load the voice */
+	TTS_ERR_AUDIO,		/* audio device error */
+	TTS_ERR_SYNTH,		/* synthesis failed */
+	TTS_ERR_IO,		/* label or trace output failed */
+	TTS_ERR_CANCELED,	/* PCM callback stopped the delivery */
+	TTS_ERR_ABORTED,	/* startup step gave up as another one failed */
+};
+
+typedef struct tts_param {
+	/* if NULL, text input is not available */
+	const char *dn_mecab;
+	/* if NULL, only labels are made (tts_write_label()) */
+	const char *fn_voice;
+	/* ALSA device; if NULL, PCM is delivered via callback only */
+	const char *pcm_name;
+
+	FILE *logfp;
+	trace_format_t trace_format;
+
+	/* engine parameters; negative ones keep the voice's defaults */
+	int sampling_rate;
+	int fperiod;
+	double alpha;
+	double beta;
+	double half_tone;
+	int audio_buff_size;
+	double uv_threshold;
+	double gv_weight_mgc;
+	double gv_weight_lf0;
+#ifdef HTS_MELP
+	double gv_weight_lpf;
+#endif	/* HTS_MELP */
+	double speed;
+
+	int nr_jobs;		/* parallel synthesis jobs per utterance */
+	int compact_model;	/* half-precision, shared PDFs of the voice */
+	int trim_ms;		/* trailing silence kept; if negative, no trim */
+	int use_mixer;		/* play via the software mixer (see below) */
+	double mixer_gain;	/* of the context's own source */
+	int mixer_priority;
+	size_t chunk_len;	/* samples per callback; if 0, whole utterance */
+} tts_param_t;
+
+/*
+ * Called with PCM chunks pointing into the context's buffer, valid until
+ * the callback returns.  A negative return stops the delivery.
+ */
+typedef int (*tts_pcm_cb_t)(const short *pcm, size_t pcm_len, void *arg);
+
+/* startup steps, run concurrently by tts_init() */
+enum {
+	TTS_STEP_AUDIO,		/* play_init() and the mixer */
+	TTS_STEP_DIC,		/* Mecab_load() */
+	TTS_STEP_VOICE,		/* HTS_Engine_load() and the setters */
+	TTS_NR_STEPS,
+};
+
+typedef struct tts_stat {
+	size_t model_bytes;		/* PDF payload before compaction */
+	size_t model_compact_bytes;	/* and after; 0 unless compacted */
+	int lead_trimmed_ms;		/* of the last utterance */
+	int trail_trimmed_ms;
+	/* ms since tts_init() was called; negative if not run */
+	struct {
+		double begin_ms;
+		double end_ms;
+	} step[TTS_NR_STEPS];
+	double startup_ms;
+} tts_stat_t;
+
+extern void tts_param_init(tts_param_t *param);
+extern int tts_init(tts_handle_t *tts_h, const tts_param_t *param);
+extern void tts_exit(tts_handle_t tts_h);
+/* if cb is NULL, PCM goes to the audio device (or the mixer) */
+extern int tts_synthesize(tts_handle_t tts_h, const char *txt,
+			  tts_pcm_cb_t cb, void *arg);
+extern int tts_synthesize_label(tts_handle_t tts_h,
+				char **label, int label_size,
+				tts_pcm_cb_t cb, void *arg);
+extern int tts_write_label(tts_handle_t tts_h, const char *txt, FILE *fp);
+/*
+ * With use_mixer, utterances queue on the context's own mixer source and
+ * play one after another.  Extra sources sound concurrently with it, e.g.
+ * alerts over announcements; while a source of higher priority sounds,
+ * the others are ducked.  Close them before tts_exit().
+ */
+typedef struct tts_source *tts_source_t;
+
+extern int tts_source_open(tts_handle_t tts_h, double gain, int priority,
+			   tts_source_t *src);
+extern void tts_source_close(tts_source_t src);
+/* as tts_synthesize() to the audio device, but queued on src */
+extern int tts_synthesize_source(tts_handle_t tts_h, tts_source_t src,
+				 const char *txt);
+/*
+ * "次は{東京}です": the carrier text is rendered once here, with the
+ * sample filler in braces.  Returns the template id.
+ */
+extern int tts_template_add(tts_handle_t tts_h, const char *tmpl);
+extern int tts_template_nr_slots(tts_handle_t tts_h, int id);
+/* slot_txt holds a text for each slot of the template */
+extern int tts_template_synthesize(tts_handle_t tts_h, int id,
+				   const char * const *slot_txt,
+				   tts_pcm_cb_t cb, void *arg);
+extern void tts_get_stat(tts_handle_t tts_h, tts_stat_t *stat);
+extern const char *tts_strerror(int err);
+
+#endif	/* _TTS_H */
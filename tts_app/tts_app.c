@@ -39,28 +39,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdarg.h>
 #include <string.h>
-#include <math.h>
 
-/* Main headers */
-#include "mecab.h"
-#include "njd.h"
-#include "jpcommon.h"
 #include "HTS_engine.h"
 
-/* Sub headers */
-#include "text2mecab.h"
-#include "mecab2njd.h"
-#include "njd_set_pronunciation.h"
-#include "njd_set_digit.h"
-#include "njd_set_accent_phrase.h"
-#include "njd_set_accent_type.h"
-#include "njd_set_unvoiced_vowel.h"
-#include "njd_set_long_vowel.h"
-#include "njd2jpcommon.h"
-
-#include "play.h"
+#include "tts.h"
+#include "label_io.h"
 #include "debug.h"
 
 #define MAXBUFLEN 1024
@@ -69,154 +53,136 @@ struct app {
 	char *txtfn;
 	FILE *logfp;
 
-	/* directory name of dictionary */
-	char *dn_mecab;
-
-	/* HTS voice file name */
-	char *fn_voice;
-
-	/* global parameter */
-	int sampling_rate;
-	int fperiod;
-	double alpha;
-	double beta;
-	double half_tone;
-	int audio_buff_size;
-	double uv_threshold;
-	double gv_weight_mgc;
-	double gv_weight_lf0;
-#ifdef HTS_MELP
-	double gv_weight_lpf;
-#endif	/* HTS_MELP */
+	/* label stream written by the front end / read by the back end */
+	FILE *label_outfp;
+	FILE *label_infp;
 
-	double speed;
+	/* carrier-phrase template, e.g. "次は{東京}です" */
+	char *tmpl;
+	int tmpl_id;
+	int nr_slots;
+	const char **slot;	/* tab-separated texts of the input line */
 
-	Mecab mecab;
-	NJD njd;
-	JPCommon jpcommon;
-	HTS_Engine engine;
-	short *pcm;
+	/* print the startup timeline */
+	int report_startup;
 
-	play_handle_t play_h;
-	play_info_t play_info;
+	/* with -mx, lines starting with '!' go to this source */
+	int use_alert;
+	tts_source_t alert;
+
+	tts_param_t param;
+	tts_handle_t tts_h;
 };
 
-static int setup(struct app *app)
+static void report_startup(struct app *app)
 {
-#ifdef HTS_MELP
-#define NR_STREAMS	3
-#else
-#define NR_STREAMS	2
-#endif	/* HTS_MELP */
-	double gv_weight[] = {
-		app->gv_weight_mgc,
-		app->gv_weight_lf0,
-#ifdef HTS_MELP
-		app->gv_weight_lpf
-#endif	/* HTS_MELP */
+	static const char * const name[TTS_NR_STEPS] = {
+		[TTS_STEP_AUDIO] = "audio device",
+		[TTS_STEP_DIC] = "dictionary",
+		[TTS_STEP_VOICE] = "voice",
 	};
+	tts_stat_t stat;
 	int i;
 
-	app->play_h = play_init(&app->play_info, "default",
-				SND_PCM_FORMAT_S16_LE, 1, app->sampling_rate,
-				500000, 8);
-
-	Mecab_initialize(&app->mecab);
-	if (Mecab_load(&app->mecab, app->dn_mecab) != TRUE)
-		return -1;
-
-	NJD_initialize(&app->njd);
+	tts_get_stat(app->tts_h, &stat);
+	for (i = 0; i < TTS_NR_STEPS; i++) {
+		if (stat.step[i].begin_ms < 0.0)
+			continue;
+		fprintf(stderr, "startup: %-12s %8.1f - %8.1f ms (%8.1f ms)\n",
+			name[i], stat.step[i].begin_ms, stat.step[i].end_ms,
+			stat.step[i].end_ms - stat.step[i].begin_ms);
+	}
+	fprintf(stderr, "startup: %-12s %8.1f ms\n", "total",
+		stat.startup_ms);
+}
 
-	JPCommon_initialize(&app->jpcommon);
+/* a line of the template mode has a text for each slot, no more or less */
+static int split_slots(struct app *app, char *txt)
+{
+	int nr_texts = 1;
+	char *p;
+	int i;
 
-	HTS_Engine_initialize(&app->engine);
-	if (HTS_Engine_load(&app->engine, &app->fn_voice, 1) != TRUE)
+	txt[strcspn(txt, "\r\n")] = '\0';
+	for (p = txt; (p = strchr(p, '\t')) != NULL; p++)
+		nr_texts++;
+	if (app->nr_slots == 0)
+		return 0;
+	if (nr_texts != app->nr_slots) {
+		app_error("%d tab-separated texts given, "
+			  "the template has %d slots.\n",
+			  nr_texts, app->nr_slots);
 		return -1;
-	HTS_Engine_set_sampling_frequency(&app->engine,
-					  (size_t)app->sampling_rate);
-	if (app->fperiod >= 0)
-		HTS_Engine_set_fperiod(&app->engine, app->fperiod);
-	if (app->alpha >= 0.0)
-		HTS_Engine_set_alpha(&app->engine, app->alpha);
-	if (app->beta >= 0.0)
-		HTS_Engine_set_beta(&app->engine, app->beta);
-	if (app->half_tone >= 0.0)
-		HTS_Engine_add_half_tone(&app->engine, app->half_tone);
-	if (app->audio_buff_size > 0)
-		HTS_Engine_set_audio_buff_size(&app->engine,
-					       app->audio_buff_size);
-	if (app->uv_threshold >= 0.0)
-		HTS_Engine_set_msd_threshold(&app->engine, 1,
-					     app->uv_threshold);
-	if (app->speed >= 0.0)
-		HTS_Engine_set_speed(&app->engine, app->speed);
-	for (i = 0; i < NR_STREAMS; i++)
-		if (gv_weight[i] >= 0.0)
-			HTS_Engine_set_gv_weight(&app->engine, i, gv_weight[i]);
+	}
 
+	for (i = 0; i < app->nr_slots; i++) {
+		app->slot[i] = txt;
+		txt += strcspn(txt, "\t");
+		if (*txt != '\0')
+			*txt++ = '\0';
+	}
 	return 0;
 }
 
-static int synthesize(struct app *app, char *txt)
+static int synthesize_template(struct app *app)
 {
-	char buff[MAXBUFLEN];
-	int label_size;
-	int r = -1;
-
-	text2mecab(buff, txt);
-	Mecab_analysis(&app->mecab, buff);
-	mecab2njd(&app->njd, Mecab_get_feature(&app->mecab),
-		  Mecab_get_size(&app->mecab));
-	njd_set_pronunciation(&app->njd);
-	njd_set_digit(&app->njd);
-	njd_set_accent_phrase(&app->njd);
-	njd_set_accent_type(&app->njd);
-	njd_set_unvoiced_vowel(&app->njd);
-	njd_set_long_vowel(&app->njd);
-	njd2jpcommon(&app->jpcommon, &app->njd);
-	JPCommon_make_label(&app->jpcommon);
-	label_size = JPCommon_get_label_size(&app->jpcommon);
-	if (label_size > 2) {
-		if (HTS_Engine_synthesize_from_strings(
-				&app->engine,
-				JPCommon_get_label_feature(&app->jpcommon),
-				label_size) == TRUE) {
-			unsigned int pcm_len;
-			r = 0;	/* success */
-			pcm_len = HTS_Engine_get_generated_speech_size(
-					&app->engine);
-			app->pcm = malloc(pcm_len * sizeof(short));
-			HTS_Engine_get_generated_speech(&app->engine, app->pcm);
-			play_write(app->play_h, app->pcm,
-				   pcm_len * sizeof(short));
-		}
+	return tts_template_synthesize(app->tts_h, app->tmpl_id, app->slot,
+				       NULL, NULL);
+}
 
-		if (app->logfp) {
-			fprintf(app->logfp, "[Text analysis result]\n");
-			NJD_fprint(&app->njd, app->logfp);
-			fprintf(app->logfp, "\n[Output label]\n");
-			HTS_Engine_save_label(&app->engine, app->logfp);
-			fprintf(app->logfp, "\n");
-			HTS_Engine_save_information(&app->engine, app->logfp);
-		}
-		HTS_Engine_refresh(&app->engine);
+static int synthesize(struct app *app, char *txt)
+{
+	tts_stat_t stat;
+	int r;
+
+	if (app->label_outfp != NULL)
+		return tts_write_label(app->tts_h, txt, app->label_outfp);
+	if (app->tmpl != NULL)
+		return synthesize_template(app);
+
+	if (app->alert != NULL && txt[0] == '!')
+		r = tts_synthesize_source(app->tts_h, app->alert, txt + 1);
+	else
+		r = tts_synthesize(app->tts_h, txt, NULL, NULL);
+	if (r == TTS_OK && app->param.trim_ms >= 0) {
+		tts_get_stat(app->tts_h, &stat);
+		fprintf(stderr,
+			"silence trimmed: %d ms leading, %d ms trailing\n",
+			stat.lead_trimmed_ms, stat.trail_trimmed_ms);
 	}
-	JPCommon_refresh(&app->jpcommon);
-	NJD_refresh(&app->njd);
-	Mecab_refresh(&app->mecab);
 
 	return r;
 }
 
-static void cleanup(struct app *app)
+/* back end fed by a label stream or a full-context label file */
+static int synthesize_label_stream(struct app *app)
 {
-	Mecab_clear(&app->mecab);
-	NJD_clear(&app->njd);
-	JPCommon_clear(&app->jpcommon);
-	HTS_Engine_clear(&app->engine);
-	play_drain(app->play_h);
-	play_exit(app->play_h);
-	free(app->pcm);
+	label_reader_t reader;
+	tts_stat_t stat;
+	char **label;
+	int label_size;
+	int r, ret = TTS_OK;
+
+	reader = label_open(app->label_infp);
+	if (reader == NULL)
+		return -TTS_ERR_IO;
+	while ((r = label_read(reader, &label, &label_size)) > 0) {
+		r = tts_synthesize_label(app->tts_h, label, label_size,
+					 NULL, NULL);
+		if (r < 0) {
+			ret = r;
+			continue;
+		}
+		if (app->param.trim_ms >= 0) {
+			tts_get_stat(app->tts_h, &stat);
+			fprintf(stderr,
+				"silence trimmed: %d ms leading, %d ms trailing\n",
+				stat.lead_trimmed_ms, stat.trail_trimmed_ms);
+		}
+	}
+	label_close(reader);
+
+	return (r < 0) ? -TTS_ERR_IO : ret;
 }
 
 static void usage(void)
@@ -248,6 +214,7 @@ static void usage(void)
 		"    -x  dir         : dictionary directory                                    [  N/A]\n"
 		"    -m  htsvoice   : HTS voice files                                         [  N/A]\n"
 		"    -ot s          : filename of output trace information                    [  N/A]\n"
+		"    -otb s         : filename of output trace information (binary)           [  N/A]\n"
 		"    -s  i          : sampling frequency                                      [48000][   1--48000]\n"
 		"    -p  i          : frame period (point)                                    [ auto][   1--    ]\n"
 		"    -a  f          : all-pass constant                                       [ auto][ 0.0-- 1.0]\n"
@@ -261,6 +228,16 @@ static void usage(void)
 		"    -jl f          : weight of GV for low-pass filter                        [  1.0][ 0.0--    ]\n"
 #endif	/* HTS_MELP */
 		"    -z  i          : audio buffer size (if 0, turn off)                      [    0][   0--    ]\n"
+		"    -pj i          : parallel synthesis jobs per utterance                   [    1][   1--    ]\n"
+		"    -ts i          : skip leading silence and cap trailing one (ms)          [  N/A][   0--    ]\n"
+		"    -st            : report startup timeline                                 [  N/A]\n"
+		"    -cm            : compact voice model and report its memory               [  N/A]\n"
+		"    -tp s          : template with sample slot texts in {} (lines: slots)    [  N/A]\n"
+		"    -ol s          : write label stream instead of speech (\"-\": stdout)     [  N/A]\n"
+		"    -il s          : synthesize label stream or label file (\"-\": stdin)     [  N/A]\n"
+		"    -mx            : voice every input line in turn via software mixer       [  N/A]\n"
+		"    -mg f          : mixer gain of the lines                                 [  1.0][ 0.0-- 1.0]\n"
+		"    -ma            : alert lines (starting with '!') over the others         [  N/A]\n"
 		"  infile:\n"
 		"    text file                                                                [stdin]\n"
 		"\n");
@@ -281,6 +258,14 @@ static FILE *get_fp(const char *name, const char *mode)
 	return (fp);
 }
 
+/* "-" stands for stdin/stdout */
+static FILE *get_label_fp(const char *name, const char *mode)
+{
+	if (!strcmp(name, "-"))
+		return (mode[0] == 'r') ? stdin : stdout;
+	return get_fp(name, mode);
+}
+
 static int find_operand(char **argv, char **endv, const char *opt)
 {
 	if (strcmp(*argv, opt))
@@ -299,37 +284,61 @@ static int parse_arg(struct app *app, int argc, char **argv)
 	/* read command */
 	for (argv++; argv < endv; argv++) {
 		if (find_operand(argv, endv, "-x")) {
-			app->dn_mecab = *++argv;
+			app->param.dn_mecab = *++argv;
 		} else if (find_operand(argv, endv, "-m")) {
-			app->fn_voice = *++argv;
+			app->param.fn_voice = *++argv;
 		} else if (find_operand(argv, endv, "-ot")) {
 			app->logfp = get_fp(*++argv, "w");
+			app->param.trace_format = TRACE_FORMAT_TEXT;
+		} else if (find_operand(argv, endv, "-otb")) {
+			app->logfp = get_fp(*++argv, "wb");
+			app->param.trace_format = TRACE_FORMAT_BINARY;
 		} else if (!strcmp(*argv, "-h")) {
 			usage();
 		} else if (find_operand(argv, endv, "-s")) {
-			app->sampling_rate = atoi(*++argv);
+			app->param.sampling_rate = atoi(*++argv);
 		} else if (find_operand(argv, endv, "-p")) {
-			app->fperiod = atoi(*++argv);
+			app->param.fperiod = atoi(*++argv);
 		} else if (find_operand(argv, endv, "-a")) {
-			app->alpha = atof(*++argv);
+			app->param.alpha = atof(*++argv);
 		} else if (find_operand(argv, endv, "-b")) {
-			app->beta = atof(*++argv);
+			app->param.beta = atof(*++argv);
 		} else if (find_operand(argv, endv, "-r")) {
-			app->speed = atof(*++argv);
+			app->param.speed = atof(*++argv);
 		} else if (find_operand(argv, endv, "-fm")) {
-			app->half_tone = atof(*++argv);
+			app->param.half_tone = atof(*++argv);
 		} else if (find_operand(argv, endv, "-u")) {
-			app->uv_threshold = atof(*++argv);
+			app->param.uv_threshold = atof(*++argv);
 		} else if (find_operand(argv, endv, "-jm")) {
-			app->gv_weight_mgc = atof(*++argv);
+			app->param.gv_weight_mgc = atof(*++argv);
 		} else if (find_operand(argv, endv, "-jf")) {
-			app->gv_weight_lf0 = atof(*++argv);
+			app->param.gv_weight_lf0 = atof(*++argv);
 #ifdef HTS_MELP
 		} else if (find_operand(argv, endv, "-jl")) {
-			app->gv_weight_lpf = atof(*++argv);
+			app->param.gv_weight_lpf = atof(*++argv);
 #endif	/* HTS_MELP */
 		} else if (find_operand(argv, endv, "-z")) {
-			app->audio_buff_size = atoi(*++argv);
+			app->param.audio_buff_size = atoi(*++argv);
+		} else if (find_operand(argv, endv, "-pj")) {
+			app->param.nr_jobs = atoi(*++argv);
+		} else if (find_operand(argv, endv, "-tp")) {
+			app->tmpl = *++argv;
+		} else if (find_operand(argv, endv, "-ol")) {
+			app->label_outfp = get_label_fp(*++argv, "wb");
+		} else if (find_operand(argv, endv, "-il")) {
+			app->label_infp = get_label_fp(*++argv, "rb");
+		} else if (find_operand(argv, endv, "-ts")) {
+			app->param.trim_ms = atoi(*++argv);
+		} else if (!strcmp(*argv, "-st")) {
+			app->report_startup = 1;
+		} else if (!strcmp(*argv, "-cm")) {
+			app->param.compact_model = 1;
+		} else if (!strcmp(*argv, "-mx")) {
+			app->param.use_mixer = 1;
+		} else if (find_operand(argv, endv, "-mg")) {
+			app->param.mixer_gain = atof(*++argv);
+		} else if (!strcmp(*argv, "-ma")) {
+			app->use_alert = 1;
 		} else if ((*argv)[0] == '-') {
 			app_error("Invalid option %s.\n", *argv);
 			exit(1);
@@ -339,12 +348,23 @@ static int parse_arg(struct app *app, int argc, char **argv)
 	}
 
 	/* sanity check */
-	if (app->fn_voice == NULL) {
+	if (app->label_outfp != NULL && app->label_infp != NULL) {
+		app_error("-ol and -il are exclusive.\n");
+		exit(1);
+	} else if (app->tmpl != NULL &&
+		   (app->label_outfp != NULL || app->label_infp != NULL)) {
+		app_error("-tp cannot be used with -ol or -il.\n");
+		exit(1);
+	} else if (app->param.fn_voice == NULL && app->label_outfp == NULL) {
 		app_error("HTS void is not specified.\n");
 		exit(1);
-	} else if (app->dn_mecab == NULL) {
+	} else if (app->param.dn_mecab == NULL && app->label_infp == NULL) {
 		app_error("dictionary directory is not specified.\n");
 		exit(1);
+	} else if (app->param.nr_jobs > 1 && app->param.audio_buff_size > 0) {
+		/* job engines would share the HTS audio buffer */
+		app_error("-pj cannot be used with -z.\n");
+		exit(1);
 	}
 
 	return 0;
@@ -355,52 +375,119 @@ int main(int argc, char **argv)
 	struct app app;
 	FILE *txtfp;
 	char buff[MAXBUFLEN];
-	int ret = 0;
+	int r, ret = 0;
 
 	if (argc == 1)
 		usage();
 
 	/* init */
 	memset(&app, 0, sizeof(app));
-
-	app.sampling_rate = 48000;
-	app.fperiod = -1;
-	app.alpha = -1.0;
-	app.beta = -1.0;
-	app.half_tone = -1.0;
-	app.audio_buff_size = 0;
-	app.uv_threshold = -1.0;
-	app.gv_weight_mgc = -1.0;
-	app.gv_weight_lf0 = -1.0;
-#ifdef HTS_MELP
-	app.gv_weight_lpf = -1.0;
-#endif	/* HTS_MELP */
-	app.speed = -1.0;
+	tts_param_init(&app.param);
 
 	parse_arg(&app, argc, argv);
 
 	txtfp = (app.txtfn != NULL) ? get_fp(app.txtfn, "rt") : stdin;
 
+	/* -ol runs the front end only, -il the back end only */
+	app.param.logfp = app.logfp;
+	if (app.label_outfp != NULL) {
+		app.param.fn_voice = NULL;
+		if (label_write_header(app.label_outfp) < 0) {
+			ret = 1;
+			goto out;
+		}
+	} else {
+		app.param.pcm_name = "default";
+	}
+	if (app.label_infp != NULL)
+		app.param.dn_mecab = NULL;
+
 	/* initialize and load */
-	if (setup(&app) < 0)
+	r = tts_init(&app.tts_h, &app.param);
+	if (r < 0) {
+		app_error("%s.\n", tts_strerror(r));
+		ret = 1;
 		goto out;
+	}
+	if (app.report_startup)
+		report_startup(&app);
+	if (app.param.compact_model) {
+		tts_stat_t stat;
+
+		tts_get_stat(app.tts_h, &stat);
+		fprintf(stderr, "model PDF payload: %zu -> %zu bytes\n",
+			stat.model_bytes, stat.model_compact_bytes);
+	}
+	if (app.use_alert && app.param.use_mixer) {
+		/* ducks the regular lines while it sounds */
+		r = tts_source_open(app.tts_h, 1.0, 1, &app.alert);
+		if (r < 0) {
+			app_error("alert source: %s.\n", tts_strerror(r));
+			ret = 1;
+			goto out;
+		}
+	}
+	if (app.tmpl != NULL) {
+		app.tmpl_id = tts_template_add(app.tts_h, app.tmpl);
+		if (app.tmpl_id < 0) {
+			app_error("template: %s.\n", tts_strerror(app.tmpl_id));
+			ret = 1;
+			goto out;
+		}
+		app.nr_slots = tts_template_nr_slots(app.tts_h, app.tmpl_id);
+		app.slot = calloc(app.nr_slots + 1, sizeof(char *));
+		if (app.slot == NULL) {
+			app_error("template: %s.\n",
+				  tts_strerror(-TTS_ERR_NOMEM));
+			ret = 1;
+			goto out;
+		}
+	}
 
 	/* synthesis */
-	fgets(buff, MAXBUFLEN - 1, txtfp);
-	if (synthesize(&app, buff) < 0) {
-		fprintf(stderr, "failed to synthesize.\n");
-		ret = 1;
+	if (app.label_infp != NULL) {
+		r = synthesize_label_stream(&app);
+		if (r < 0) {
+			fprintf(stderr, "failed to synthesize: %s.\n",
+				tts_strerror(r));
+			ret = 1;
+		}
+		goto out;
+	}
+	while (fgets(buff, MAXBUFLEN - 1, txtfp) != NULL) {
+		if (app.tmpl != NULL && split_slots(&app, buff) < 0) {
+			ret = 1;
+			continue;
+		}
+		r = synthesize(&app, buff);
+		if (r < 0) {
+			fprintf(stderr, "failed to synthesize: %s.\n",
+				tts_strerror(r));
+			ret = 1;
+		}
+		/* without the mixer, only the first line is spoken */
+		if (!app.param.use_mixer && app.label_outfp == NULL &&
+		    app.tmpl == NULL)
+			break;
 	}
 
 out:
 	/* cleanup */
-	cleanup(&app);
+	if (app.alert != NULL)
+		tts_source_close(app.alert);
+	if (app.tts_h != NULL)
+		tts_exit(app.tts_h);
+	free(app.slot);
 
 	/* free */
 	if (app.txtfn != NULL)
 		fclose(txtfp);
 	if (app.logfp != NULL)
 		fclose(app.logfp);
+	if (app.label_outfp != NULL && app.label_outfp != stdout)
+		fclose(app.label_outfp);
+	if (app.label_infp != NULL && app.label_infp != stdin)
+		fclose(app.label_infp);
 
 	return ret;
 }
@@ -0,0 +1,651 @@
+/*
+ *  Copyright (c) Toshihiro Kobayashi <kobacha@mwa.biglobe.ne.jp>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following
+ *   disclaimer in the documentation and/or other materials provided
+ *   with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Benchmark driver.
+ *
+ * Runs the sentences of a corpus through the whole pipeline into the
+ * ALSA "null" device and reports per-stage timings, real-time factor,
+ * time-to-first-sample and peak RSS, followed by micro-benchmarks of the
+ * parameter generation, PCM conversion, play_write() chunking and the
+ * front-end passes.  With -cm the voice model is compacted first and the
+ * process RSS around the compaction is reported.
+ * Every result is printed as one JSON object per line.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+/* Main headers */
+#include "mecab.h"
+#include "njd.h"
+#include "jpcommon.h"
+#include "HTS_engine.h"
+
+/* Sub headers */
+#include "text2mecab.h"
+#include "mecab2njd.h"
+#include "njd_set_pronunciation.h"
+#include "njd_set_digit.h"
+#include "njd_set_accent_phrase.h"
+#include "njd_set_accent_type.h"
+#include "njd_set_unvoiced_vowel.h"
+#include "njd_set_long_vowel.h"
+#include "njd2jpcommon.h"
+
+#include "play.h"
+#include "debug.h"
+
+#define MAXBUFLEN 1024
+#define MAX_SENTENCES 64
+
+/* pipeline stages, in order */
+enum {
+	ST_TEXT2MECAB,
+	ST_MECAB,
+	ST_MECAB2NJD,
+	ST_PRONUNCIATION,
+	ST_DIGIT,
+	ST_ACCENT_PHRASE,
+	ST_ACCENT_TYPE,
+	ST_UNVOICED_VOWEL,
+	ST_LONG_VOWEL,
+	ST_NJD2JPCOMMON,
+	ST_LABEL,
+	ST_STATE,
+	ST_PARAMETER,
+	ST_SAMPLE,
+	ST_PCM_CONVERT,
+	ST_PLAY,
+	NR_STAGES
+};
+
+static const char *stage_name[NR_STAGES] = {
+	"text2mecab",
+	"mecab",
+	"mecab2njd",
+	"njd_set_pronunciation",
+	"njd_set_digit",
+	"njd_set_accent_phrase",
+	"njd_set_accent_type",
+	"njd_set_unvoiced_vowel",
+	"njd_set_long_vowel",
+	"njd2jpcommon",
+	"jpcommon_make_label",
+	"hts_state",
+	"hts_parameter",
+	"hts_sample",
+	"pcm_convert",
+	"play_write",
+};
+
+struct sentence {
+	char *class;
+	char *text;
+};
+
+struct bench {
+	char *dn_mecab;
+	char *fn_voice;
+	char *fn_corpus;
+	int sampling_rate;
+	int iterations;
+	int compact_model;
+	int model_compacted;
+
+	struct sentence sentence[MAX_SENTENCES];
+	int nr_sentences;
+
+	Mecab mecab;
+	NJD njd;
+	JPCommon jpcommon;
+	HTS_Engine engine;
+	HTS_BandWork band_work;
+	short *pcm;
+	size_t pcm_len;
+
+	play_handle_t play_h;
+	play_info_t play_info;
+};
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static long peak_rss_kb(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss;
+}
+
+/*
+ * resident set size in kB, or -1 if it cannot be read.  Free heap pages
+ * are given back first so that freed model memory is not counted.
+ */
+static long rss_kb(void)
+{
+	FILE *fp;
+	long size, resident;
+
+#ifdef __GLIBC__
+	malloc_trim(0);
+#endif
+	fp = fopen("/proc/self/statm", "r");
+	if (fp == NULL)
+		return -1;
+	if (fscanf(fp, "%ld %ld", &size, &resident) != 2)
+		resident = -1;
+	fclose(fp);
+
+	return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/* class names go into the JSON output unescaped */
+static int valid_class(const char *class)
+{
+	return class[0] != '\0' &&
+	       class[strspn(class, "abcdefghijklmnopqrstuvwxyz_")] == '\0';
+}
+
+static int load_corpus(struct bench *bench)
+{
+	FILE *fp;
+	char line[MAXBUFLEN];
+	char *tab;
+
+	fp = fopen(bench->fn_corpus, "rt");
+	if (fp == NULL) {
+		app_error("Cannot open %s.\n", bench->fn_corpus);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp) != NULL &&
+	       bench->nr_sentences < MAX_SENTENCES) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] == '#' || (tab = strchr(line, '\t')) == NULL)
+			continue;
+		*tab = '\0';
+		if (!valid_class(line)) {
+			app_error("invalid class \"%s\" in %s (must be [a-z_]).\n",
+				  line, bench->fn_corpus);
+			continue;
+		}
+		bench->sentence[bench->nr_sentences].class = strdup(line);
+		bench->sentence[bench->nr_sentences].text = strdup(tab + 1);
+		bench->nr_sentences++;
+	}
+	fclose(fp);
+
+	return bench->nr_sentences > 0 ? 0 : -1;
+}
+
+/* front end: text to NJD to labels, timing each pass into t[] */
+static void front_end(struct bench *bench, const char *txt, double *t)
+{
+	char buff[MAXBUFLEN];
+	double t0 = now_ms();
+
+#define STAGE(st, call) \
+	do { \
+		call; \
+		t[st] += now_ms() - t0; \
+		t0 = now_ms(); \
+	} while (0)
+
+	STAGE(ST_TEXT2MECAB, text2mecab(buff, txt));
+	STAGE(ST_MECAB, Mecab_analysis(&bench->mecab, buff));
+	STAGE(ST_MECAB2NJD,
+	      mecab2njd(&bench->njd, Mecab_get_feature(&bench->mecab),
+			Mecab_get_size(&bench->mecab)));
+	STAGE(ST_PRONUNCIATION, njd_set_pronunciation(&bench->njd));
+	STAGE(ST_DIGIT, njd_set_digit(&bench->njd));
+	STAGE(ST_ACCENT_PHRASE, njd_set_accent_phrase(&bench->njd));
+	STAGE(ST_ACCENT_TYPE, njd_set_accent_type(&bench->njd));
+	STAGE(ST_UNVOICED_VOWEL, njd_set_unvoiced_vowel(&bench->njd));
+	STAGE(ST_LONG_VOWEL, njd_set_long_vowel(&bench->njd));
+	STAGE(ST_NJD2JPCOMMON, njd2jpcommon(&bench->jpcommon, &bench->njd));
+	STAGE(ST_LABEL, JPCommon_make_label(&bench->jpcommon));
+#undef STAGE
+}
+
+static void refresh(struct bench *bench)
+{
+	HTS_Engine_refresh(&bench->engine);
+	JPCommon_refresh(&bench->jpcommon);
+	NJD_refresh(&bench->njd);
+	Mecab_refresh(&bench->mecab);
+}
+
+/* whole pipeline for one sentence.  t[] accumulates stage times */
+static int run_pipeline(struct bench *bench, const char *txt,
+			double *t, double *ttfs)
+{
+	size_t chunk_len = bench->play_info.chunk_bytes / sizeof(short);
+	double start = now_ms();
+	double t0;
+	int label_size;
+
+	front_end(bench, txt, t);
+	label_size = JPCommon_get_label_size(&bench->jpcommon);
+	if (label_size <= 2) {
+		refresh(bench);
+		return -1;
+	}
+
+	t0 = now_ms();
+	if (HTS_Engine_generate_state_sequence_from_strings(&bench->engine,
+			JPCommon_get_label_feature(&bench->jpcommon),
+			label_size) != TRUE)
+		goto err;
+	t[ST_STATE] += now_ms() - t0;
+	t0 = now_ms();
+	if (HTS_Engine_generate_parameter_sequence_banded(&bench->engine,
+			&bench->band_work) != TRUE)
+		goto err;
+	t[ST_PARAMETER] += now_ms() - t0;
+	t0 = now_ms();
+	if (HTS_Engine_generate_sample_sequence(&bench->engine) != TRUE)
+		goto err;
+	t[ST_SAMPLE] += now_ms() - t0;
+
+	t0 = now_ms();
+	bench->pcm_len = HTS_Engine_get_generated_speech_size(&bench->engine);
+	free(bench->pcm);
+	bench->pcm = malloc(bench->pcm_len * sizeof(short));
+	HTS_Engine_get_generated_speech(&bench->engine, bench->pcm);
+	t[ST_PCM_CONVERT] += now_ms() - t0;
+
+	/* the first period is written separately for time-to-first-sample */
+	t0 = now_ms();
+	if (chunk_len > bench->pcm_len)
+		chunk_len = bench->pcm_len;
+	play_start(bench->play_h);
+	play_write(bench->play_h, bench->pcm, chunk_len * sizeof(short));
+	*ttfs = now_ms() - start;
+	if (bench->pcm_len > chunk_len)
+		play_write(bench->play_h, bench->pcm + chunk_len,
+			   (bench->pcm_len - chunk_len) * sizeof(short));
+	play_drain(bench->play_h);
+	t[ST_PLAY] += now_ms() - t0;
+
+	refresh(bench);
+	return 0;
+
+err:
+	refresh(bench);
+	return -1;
+}
+
+static void bench_sentences(struct bench *bench)
+{
+	double t[NR_STAGES];
+	double ttfs, ttfs_sum, total, audio_ms;
+	int i, n, st;
+
+	for (i = 0; i < bench->nr_sentences; i++) {
+		memset(t, 0, sizeof(t));
+		ttfs_sum = 0.0;
+		for (n = 0; n < bench->iterations; n++) {
+			if (run_pipeline(bench, bench->sentence[i].text,
+					 t, &ttfs) < 0) {
+				app_error("failed to synthesize: %s\n",
+					  bench->sentence[i].text);
+				break;
+			}
+			ttfs_sum += ttfs;
+		}
+		if (n == 0)
+			continue;
+
+		total = 0.0;
+		audio_ms = bench->pcm_len * 1000.0 / bench->play_info.rate;
+		printf("{\"type\":\"sentence\",\"index\":%d,\"class\":\"%s\","
+		       "\"bytes\":%zu,\"iterations\":%d,\"audio_ms\":%.3f,"
+		       "\"stage_ms\":{", i, bench->sentence[i].class,
+		       strlen(bench->sentence[i].text), n, audio_ms);
+		for (st = 0; st < NR_STAGES; st++) {
+			printf("%s\"%s\":%.4f", st ? "," : "",
+			       stage_name[st], t[st] / n);
+			/* playback into the null device is not synthesis */
+			if (st != ST_PLAY)
+				total += t[st] / n;
+		}
+		printf("},\"synthesis_ms\":%.4f,\"rtf\":%.5f,"
+		       "\"ttfs_ms\":%.4f}\n", total,
+		       audio_ms > 0.0 ? total / audio_ms : 0.0, ttfs_sum / n);
+	}
+}
+
+/* micro-benchmark: reference and banded parameter generation */
+static void bench_parameter(struct bench *bench)
+{
+	const char *txt = bench->sentence[0].text;
+	double t[NR_STAGES];
+	double t0, ref_ms = 0.0, band_ms = 0.0;
+	size_t frames = 0;
+	int i, n, reps = bench->iterations * 4;
+
+	/* the longest sentence */
+	for (i = 1; i < bench->nr_sentences; i++)
+		if (strlen(bench->sentence[i].text) > strlen(txt))
+			txt = bench->sentence[i].text;
+
+	memset(t, 0, sizeof(t));
+	front_end(bench, txt, t);
+	for (n = 0; n < reps * 2; n++) {
+		if (HTS_Engine_generate_state_sequence_from_strings(&bench->engine,
+				JPCommon_get_label_feature(&bench->jpcommon),
+				JPCommon_get_label_size(&bench->jpcommon)) != TRUE)
+			break;
+		frames = HTS_Engine_get_total_frame(&bench->engine);
+		/* alternate so that both see the same cache and clock */
+		t0 = now_ms();
+		if (n % 2) {
+			HTS_Engine_generate_parameter_sequence_banded(
+				&bench->engine, &bench->band_work);
+			band_ms += now_ms() - t0;
+		} else {
+			HTS_Engine_generate_parameter_sequence(&bench->engine);
+			ref_ms += now_ms() - t0;
+		}
+		HTS_Engine_refresh(&bench->engine);
+	}
+	refresh(bench);
+	if (n < reps * 2)
+		return;
+
+	printf("{\"type\":\"micro\",\"name\":\"parameter\",\"frames\":%zu,"
+	       "\"reps\":%d,\"reference_ms\":%.4f,\"banded_ms\":%.4f,"
+	       "\"speedup\":%.3f}\n", frames, reps, ref_ms / reps,
+	       band_ms / reps, band_ms > 0.0 ? ref_ms / band_ms : 0.0);
+}
+
+/* micro-benchmark: HTS_Engine_get_generated_speech() of the last sentence */
+static void bench_pcm_convert(struct bench *bench)
+{
+	const char *txt = bench->sentence[bench->nr_sentences - 1].text;
+	double t[NR_STAGES];
+	double t0, elapsed;
+	size_t len;
+	int n, reps = bench->iterations * 20;
+
+	memset(t, 0, sizeof(t));
+	front_end(bench, txt, t);
+	if (HTS_Engine_synthesize_from_strings(&bench->engine,
+			JPCommon_get_label_feature(&bench->jpcommon),
+			JPCommon_get_label_size(&bench->jpcommon)) != TRUE) {
+		refresh(bench);
+		return;
+	}
+	len = HTS_Engine_get_generated_speech_size(&bench->engine);
+	free(bench->pcm);
+	bench->pcm = malloc(len * sizeof(short));
+	t0 = now_ms();
+	for (n = 0; n < reps; n++)
+		HTS_Engine_get_generated_speech(&bench->engine, bench->pcm);
+	elapsed = now_ms() - t0;
+	refresh(bench);
+
+	printf("{\"type\":\"micro\",\"name\":\"pcm_convert\",\"samples\":%zu,"
+	       "\"reps\":%d,\"ns_per_sample\":%.4f}\n", len, reps,
+	       elapsed * 1000000.0 / ((double)len * reps));
+}
+
+/* micro-benchmark: play_write() of 10 seconds of audio in various chunks */
+static void bench_play_write(struct bench *bench)
+{
+	static const size_t periods[] = { 1, 4, 16, 0 };
+	size_t len = (size_t)bench->play_info.rate * 10;
+	size_t chunk_len, off, n;
+	short *buf;
+	double t0, elapsed;
+	int i;
+
+	buf = calloc(len, sizeof(short));
+	if (buf == NULL)
+		return;
+	for (i = 0; i < (int)(sizeof(periods) / sizeof(periods[0])); i++) {
+		/* 0 means the whole buffer in one call */
+		chunk_len = periods[i] ?
+			periods[i] * bench->play_info.chunk_bytes / sizeof(short) :
+			len;
+		t0 = now_ms();
+		play_start(bench->play_h);
+		for (off = 0; off < len; off += n) {
+			n = (len - off < chunk_len) ? len - off : chunk_len;
+			play_write(bench->play_h, buf + off, n * sizeof(short));
+		}
+		play_drain(bench->play_h);
+		elapsed = now_ms() - t0;
+		printf("{\"type\":\"micro\",\"name\":\"play_write\","
+		       "\"chunk_samples\":%zu,\"samples\":%zu,"
+		       "\"ms\":%.4f,\"ns_per_sample\":%.4f}\n",
+		       chunk_len, len, elapsed, elapsed * 1000000.0 / len);
+	}
+	free(buf);
+}
+
+/* micro-benchmark: front-end passes on each sentence class */
+static void bench_front_end(struct bench *bench)
+{
+	double t[NR_STAGES];
+	int reps = bench->iterations * 10;
+	int i, n, st;
+
+	for (i = 0; i < bench->nr_sentences; i++) {
+		/* one representative per class */
+		if (i > 0 && !strcmp(bench->sentence[i].class,
+				     bench->sentence[i - 1].class))
+			continue;
+		memset(t, 0, sizeof(t));
+		for (n = 0; n < reps; n++) {
+			front_end(bench, bench->sentence[i].text, t);
+			refresh(bench);
+		}
+		printf("{\"type\":\"micro\",\"name\":\"front_end\","
+		       "\"class\":\"%s\",\"reps\":%d,\"stage_ms\":{",
+		       bench->sentence[i].class, reps);
+		for (st = ST_TEXT2MECAB; st <= ST_LABEL; st++)
+			printf("%s\"%s\":%.4f", st ? "," : "",
+			       stage_name[st], t[st] / reps);
+		printf("}}\n");
+	}
+}
+
+/* the benchmarks that follow run on the compacted model */
+static void bench_compact_model(struct bench *bench)
+{
+	size_t bytes = 0, compact_bytes = 0;
+	long rss, compact_rss;
+
+	rss = rss_kb();
+	HTS_Engine_compact_model(&bench->engine, &bytes, &compact_bytes);
+	compact_rss = rss_kb();
+	bench->model_compacted = 1;
+
+	printf("{\"type\":\"compact_model\",\"pdf_bytes\":%zu,"
+	       "\"compact_pdf_bytes\":%zu,\"rss_kb\":%ld,"
+	       "\"compact_rss_kb\":%ld}\n",
+	       bytes, compact_bytes, rss, compact_rss);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"tts_bench - benchmark driver of tts_app\n"
+		"\n"
+		"  usage:\n"
+		"       tts_bench [ options ]\n"
+		"  options:                                                                   [  def]\n"
+		"    -x  dir         : dictionary directory                                    [  N/A]\n"
+		"    -m  htsvoice   : HTS voice file                                          [  N/A]\n"
+		"    -c  s          : corpus file (class<TAB>sentence per line)               [bench_corpus.txt]\n"
+		"    -n  i          : iterations per sentence                                 [    5]\n"
+		"    -s  i          : sampling frequency                                      [48000]\n"
+		"    -cm            : compact voice model and report its memory               [  N/A]\n"
+		"\n");
+
+	exit(0);
+}
+
+static int find_operand(char **argv, char **endv, const char *opt)
+{
+	if (strcmp(*argv, opt))
+		return 0;
+	if (argv + 1 == endv) {
+		app_error("operand for %s is missing.\n", opt);
+		exit(1);
+	}
+	return 1;
+}
+
+static void parse_arg(struct bench *bench, int argc, char **argv)
+{
+	char **endv = &argv[argc];
+
+	for (argv++; argv < endv; argv++) {
+		if (find_operand(argv, endv, "-x")) {
+			bench->dn_mecab = *++argv;
+		} else if (find_operand(argv, endv, "-m")) {
+			bench->fn_voice = *++argv;
+		} else if (find_operand(argv, endv, "-c")) {
+			bench->fn_corpus = *++argv;
+		} else if (find_operand(argv, endv, "-n")) {
+			bench->iterations = atoi(*++argv);
+		} else if (find_operand(argv, endv, "-s")) {
+			bench->sampling_rate = atoi(*++argv);
+		} else if (!strcmp(*argv, "-cm")) {
+			bench->compact_model = 1;
+		} else if (!strcmp(*argv, "-h")) {
+			usage();
+		} else {
+			app_error("Invalid option %s.\n", *argv);
+			exit(1);
+		}
+	}
+
+	if (bench->fn_voice == NULL || bench->dn_mecab == NULL) {
+		app_error("both -x and -m must be specified.\n");
+		exit(1);
+	}
+	if (bench->iterations < 1)
+		bench->iterations = 1;
+}
+
+int main(int argc, char **argv)
+{
+	struct bench bench;
+	double t0, t_mecab, t_voice;
+	int ret = 1;
+	int i;
+
+	if (argc == 1)
+		usage();
+
+	memset(&bench, 0, sizeof(bench));
+	bench.fn_corpus = "bench_corpus.txt";
+	bench.sampling_rate = 48000;
+	bench.iterations = 5;
+	parse_arg(&bench, argc, argv);
+
+	if (load_corpus(&bench) < 0) {
+		app_error("no sentence in %s.\n", bench.fn_corpus);
+		return 1;
+	}
+
+	bench.play_h = play_init(&bench.play_info, "null",
+				 SND_PCM_FORMAT_S16_LE, 1, bench.sampling_rate,
+				 500000, 8);
+	if (bench.play_h == NULL)
+		return 1;
+
+	Mecab_initialize(&bench.mecab);
+	NJD_initialize(&bench.njd);
+	JPCommon_initialize(&bench.jpcommon);
+	HTS_Engine_initialize(&bench.engine);
+	HTS_BandWork_initialize(&bench.band_work);
+
+	t0 = now_ms();
+	if (Mecab_load(&bench.mecab, bench.dn_mecab) != TRUE)
+		goto out;
+	t_mecab = now_ms() - t0;
+	t0 = now_ms();
+	if (HTS_Engine_load(&bench.engine, &bench.fn_voice, 1) != TRUE)
+		goto out;
+	t_voice = now_ms() - t0;
+	HTS_Engine_set_sampling_frequency(&bench.engine,
+					  (size_t)bench.sampling_rate);
+	printf("{\"type\":\"startup\",\"mecab_load_ms\":%.3f,"
+	       "\"voice_load_ms\":%.3f,\"rss_kb\":%ld}\n",
+	       t_mecab, t_voice, peak_rss_kb());
+	if (bench.compact_model)
+		bench_compact_model(&bench);
+
+	bench_sentences(&bench);
+	bench_parameter(&bench);
+	bench_pcm_convert(&bench);
+	bench_play_write(&bench);
+	bench_front_end(&bench);
+
+	printf("{\"type\":\"summary\",\"sentences\":%d,\"iterations\":%d,"
+	       "\"peak_rss_kb\":%ld}\n",
+	       bench.nr_sentences, bench.iterations, peak_rss_kb());
+	ret = 0;
+
+out:
+	Mecab_clear(&bench.mecab);
+	NJD_clear(&bench.njd);
+	JPCommon_clear(&bench.jpcommon);
+	if (bench.model_compacted)
+		HTS_Engine_clear_compact_model(&bench.engine);
+	HTS_Engine_clear(&bench.engine);
+	HTS_BandWork_clear(&bench.band_work);
+	play_exit(bench.play_h);
+	free(bench.pcm);
+	for (i = 0; i < bench.nr_sentences; i++) {
+		free(bench.sentence[i].class);
+		free(bench.sentence[i].text);
+	}
+
+	return ret;
+}